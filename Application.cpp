@@ -54,6 +54,10 @@ Application::Application(char *infile) {
 	en1 = new EmulNet(par);
 	mp1 = (MP1Node **) malloc(par->EN_GPSZ * sizeof(MP1Node *));
 	mp2 = (MP2Node **) malloc(par->EN_GPSZ * sizeof(MP2Node *));
+	failTime.assign(par->EN_GPSZ, -1);
+	convergedAt = -1;
+	stabilizationBytes = 0;
+	loadLogged = false;
 
 	/*
 	 * Init all nodes
@@ -106,18 +110,38 @@ int Application::run()
 	for( par->globaltime = 0; par->globaltime < TOTAL_RUNNING_TIME; ++par->globaltime ) {
 		// Run the membership protocol
 		mp1Run();
+		recordConvergence();
 
 		// Wait for all nodes to join
 		if ( par->allNodesJoined == nodeCount && !allNodesJoined ) {
 			timeWhenAllNodesHaveJoined = par->getcurrtime();
 			allNodesJoined = true;
 		}
-		if ( par->getcurrtime() > timeWhenAllNodesHaveJoined + 50 ) {
+		if ( par->getcurrtime() > timeWhenAllNodesHaveJoined + 50 && par->CRUDTEST != MEMBERSHIP_TEST ) {
 			// Call the KV store functionalities
 			mp2Run();
+			recordRingConvergence();
+			if ( par->LOAD_REPORT > 0 && par->getcurrtime() % par->LOAD_REPORT == 0 ) {
+				reportLoad();
+			}
 		}
 		// Fail some nodes
-		//fail();
+		if ( par->CRUDTEST == MEMBERSHIP_TEST ) {
+			fail();
+		}
+		recordFailures();
+	}
+
+	reportGossip();
+	reportFailureDetector();
+	reportMemory();
+	if ( par->CRUDTEST != MEMBERSHIP_TEST ) {
+		reportRingBalance();
+		reportRingConvergence();
+		reportLoad();
+	}
+	if ( par->CRUDTEST == LEAVE_TEST ) {
+		reportDepartures();
 	}
 
 	// Clean up
@@ -323,6 +347,17 @@ void Application::mp2Run() {
 			updateTest();
 		} // End of update test
 
+		/*************
+		 * LEAVE TEST
+		 *************/
+		/**
+		 * Every LEAVE_INTERVAL periods one more node leaves, gracefully or by crashing.
+		 * Check how long the others take to drop it and to get every key back to REPLICATION copies.
+		 */
+		else if ( par->getcurrtime() >= TEST_TIME && LEAVE_TEST == par->CRUDTEST ) {
+			leaveTest();
+		} // End of leave test
+
 	} // end of if ( par->getcurrtime == TEST_TIME)
 }
 
@@ -364,6 +399,462 @@ void Application::fail() {
 
 }
 
+/**
+ * FUNCTION NAME: recordFailures
+ *
+ * DESCRIPTION: Remember when each node was failed, whichever test failed it
+ */
+void Application::recordFailures() {
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		if ( failTime[i] < 0 && mp1[i]->getMemberNode()->bFailed ) {
+			failTime[i] = par->getcurrtime();
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: recordConvergence
+ *
+ * DESCRIPTION: Remember the first time every node has every other node in its membership list
+ */
+void Application::recordConvergence() {
+	if ( convergedAt >= 0 ) {
+		return;
+	}
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		Member *memberNode = mp1[i]->getMemberNode();
+		if ( !memberNode->inGroup || (int)memberNode->memberList.size() != par->EN_GPSZ ) {
+			return;
+		}
+	}
+	convergedAt = par->getcurrtime();
+}
+
+/**
+ * FUNCTION NAME: reportGossip
+ *
+ * DESCRIPTION: Print how fast the membership converged and what the gossip cost
+ */
+void Application::reportGossip() {
+	cout<<endl<<"Gossip ("<<(par->GOSSIP_MODE == ZONE_GOSSIP ? "zone" : "flat")<<", "<<par->ZONES<<" zones): ";
+	if ( convergedAt >= 0 ) {
+		cout<<"converged at time "<<convergedAt;
+	}
+	else {
+		cout<<"never converged";
+	}
+	cout<<", "<<en->getSentBytes()<<" bytes sent of which "<<en->getCrossZoneBytes()<<" cross-zone, "
+		<<(double)en->getSentBytes() / par->EN_GPSZ / par->getcurrtime()<<" bytes per node per tick"<<endl;
+
+	cout<<"JOINREQs served by introducer:";
+	for ( unsigned int i = 0; i < par->INTRODUCERS.size(); i++ ) {
+		int introducer = par->INTRODUCERS[i] - 1;
+		if ( introducer >= 0 && introducer < par->EN_GPSZ ) {
+			cout<<" "<<par->INTRODUCERS[i]<<"="<<mp1[introducer]->joinRequestsServed;
+		}
+	}
+	cout<<endl;
+
+	if ( par->ANTI_ENTROPY > 0 ) {
+		long exchanges = 0, divergent = 0, entriesSent = 0, digestBytes = 0;
+		for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+			exchanges += mp1[i]->aeStats.exchanges;
+			divergent += mp1[i]->aeStats.divergent;
+			entriesSent += mp1[i]->aeStats.entriesSent;
+			digestBytes += mp1[i]->aeStats.digestBytes;
+		}
+		cout<<"Anti-entropy every "<<par->ANTI_ENTROPY<<" periods: "<<exchanges<<" exchanges of which "<<divergent
+			<<" divergent, "<<entriesSent<<" entries resent, "<<digestBytes<<" digest bytes";
+		if ( exchanges > 0 ) {
+			cout<<" ("<<(double)digestBytes / exchanges<<" per exchange)";
+		}
+		cout<<endl;
+	}
+}
+
+/**
+ * FUNCTION NAME: reportMemory
+ *
+ * DESCRIPTION: Print the memory held by the membership tables, per node in memory.log.
+ * 				Chunks shared by several tables are split evenly between them.
+ * 				Then the memory held by the rings of the KV store, against a ring
+ * 				per node.
+ */
+void Application::reportMemory() {
+	FILE *file = fopen("memory.log", "w+");
+	double total = 0, most = 0, cold = 0, plain = 0;
+
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		MemberTable &table = mp1[i]->getMemberNode()->memberList;
+		size_t privateBytes = 0;
+		double sharedBytes = 0;
+		table.memoryUsage(privateBytes, sharedBytes);
+		fprintf(file, "node %3d rows %5u private_bytes %8lu shared_bytes %10.1f\n", i + 1, table.size(), privateBytes, sharedBytes);
+		total += privateBytes + sharedBytes;
+		most = max(most, privateBytes + sharedBytes);
+		// What the id, port, incarnation and state columns take, against plain per node vectors
+		size_t hot = table.heartbeats.capacity() * sizeof(long) + table.timestamps.capacity() * sizeof(int);
+		cold += privateBytes + sharedBytes - hot;
+		plain += table.size() * (sizeof(int) + sizeof(short) + sizeof(long) + sizeof(unsigned char));
+	}
+	fclose(file);
+
+	cout<<"Membership tables: "<<total / par->EN_GPSZ<<" bytes per node (max "<<most<<"), of which shared columns "
+		<<cold / par->EN_GPSZ<<" against "<<plain / par->EN_GPSZ<<" unshared, details in memory.log"<<endl;
+
+	set<const Ring *> rings;
+	double shared = 0, unshared = 0;
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		shared_ptr<const Ring> ring = mp2[i]->getRing();
+		unshared += ring->memoryUsage();
+		if ( rings.insert(ring.get()).second ) {
+			shared += ring->memoryUsage();
+		}
+	}
+	cout<<"KV store rings: "<<rings.size()<<" distinct for "<<par->EN_GPSZ<<" nodes, "<<shared / par->EN_GPSZ
+		<<" bytes per node against "<<unshared / par->EN_GPSZ<<" unshared"<<endl;
+}
+
+/**
+ * FUNCTION NAME: spread
+ *
+ * DESCRIPTION: The largest of the values over their mean, and their coefficient of
+ * 				variation in cv. Both are 0 if the values are all 0.
+ */
+static double spread(const vector<double> &values, double &cv) {
+	double sum = 0, squares = 0, most = 0;
+	for ( unsigned int i = 0; i < values.size(); i++ ) {
+		sum += values[i];
+		squares += values[i] * values[i];
+		most = max(most, values[i]);
+	}
+	double mean = sum / values.size();
+	if ( values.empty() || mean == 0 ) {
+		cv = 0;
+		return 0;
+	}
+	cv = sqrt(max(0.0, squares / values.size() - mean * mean)) / mean;
+	return most / mean;
+}
+
+/**
+ * FUNCTION NAME: ringImbalance
+ *
+ * DESCRIPTION: Share of the key space each of the given nodes is primary for, divided
+ * 				by its weight, sampled at BALANCE_SAMPLES evenly spaced positions.
+ * 				Returns the largest share over the mean and sets cv to the
+ * 				coefficient of variation of the shares.
+ */
+static double ringImbalance(Ring &ring, vector<int> &ids, Params *par, double &cv) {
+	map<int, double> owned;
+	vector<Node> primary;
+	size_t step = (size_t)-1 / BALANCE_SAMPLES + 1;
+	for ( size_t i = 0; i < BALANCE_SAMPLES; i++ ) {
+		ring.replicasOf(i * step + step / 2, 1, primary);
+		owned[*(int *)primary[0].getAddress()->addr]++;
+	}
+	vector<double> shares;
+	for ( unsigned int i = 0; i < ids.size(); i++ ) {
+		shares.push_back(owned[ids[i]] / par->nodeWeight[ids[i]]);
+	}
+	return spread(shares, cv);
+}
+
+/**
+ * FUNCTION NAME: reportRingBalance
+ *
+ * DESCRIPTION: Print how evenly the ring positions are spread over the nodes still
+ * 				up, with one position per node and with the configured virtual nodes.
+ * 				Shares are divided by the node weights, so 1 is a perfect balance.
+ */
+void Application::reportRingBalance() {
+	Ring single, virtualNodes;
+	single.setPlacement(par->PLACEMENT);
+	virtualNodes.setPlacement(par->PLACEMENT);
+	vector<int> ids;
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		Member *memberNode = mp1[i]->getMemberNode();
+		if ( memberNode->bFailed ) {
+			continue;
+		}
+		ids.push_back(i + 1);
+		single.insertMember(memberNode->addr, 1);
+		virtualNodes.insertMember(memberNode->addr, par->getVnodes(i + 1));
+	}
+	if ( ids.empty() ) {
+		return;
+	}
+
+	double cvSingle, cvVirtual;
+	double maxSingle = ringImbalance(single, ids, par, cvSingle);
+	double maxVirtual = ringImbalance(virtualNodes, ids, par, cvVirtual);
+	cout<<"Ring balance over "<<ids.size()<<" nodes: one position each max/mean "<<maxSingle<<" cv "<<cvSingle
+		<<", "<<par->VNODES<<" vnodes per unit of weight max/mean "<<maxVirtual<<" cv "<<cvVirtual<<endl;
+}
+
+/**
+ * FUNCTION NAME: recordRingConvergence
+ *
+ * DESCRIPTION: Sample the KV store at the end of a tick: how many distinct rings the
+ * 				live nodes hold, which are the same object once they agree since rings
+ * 				are interned, how many of them miss a join or a leave, how many test
+ * 				keys lack copies on their replicas in the ring of the live nodes, and
+ * 				the bytes stabilization moved. Keys no live node holds, as deleted
+ * 				ones, are not counted.
+ */
+void Application::recordRingConvergence() {
+	ConvergenceSample sample;
+	sample.time = par->getcurrtime();
+	map<const Ring *, int> views;
+	Ring live;
+	live.setPlacement(par->PLACEMENT);
+	live.setZones(&par->nodeZone, par->ZONES);
+	long bytes = 0;
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		Member *memberNode = mp2[i]->getMemberNode();
+		bytes += mp2[i]->stabStats.bytesSent;
+		if ( memberNode->bFailed || !memberNode->inGroup ) {
+			continue;
+		}
+		views[mp2[i]->getRing().get()]++;
+		live.insertMember(memberNode->addr, par->getVnodes(i + 1));
+	}
+	sample.liveNodes = live.memberCount();
+	sample.ringViews = views.size();
+	sample.staleNodes = 0;
+	for ( map<const Ring *, int>::iterator it = views.begin(); it != views.end(); ++it ) {
+		if ( !it->first->sameMembers(live) ) {
+			sample.staleNodes += it->second;
+		}
+	}
+	sample.stabilizationBytes = bytes - stabilizationBytes;
+	stabilizationBytes = bytes;
+
+	sample.underReplicated = 0;
+	vector<Node> replicas;
+	for ( map<string, string>::iterator it = testKVPairs.begin(); it != testKVPairs.end() && !live.empty(); ++it ) {
+		bool held = false;
+		for ( int i = 0; i < par->EN_GPSZ && !held; i++ ) {
+			held = !mp2[i]->getMemberNode()->bFailed && mp2[i]->hasKey(it->first);
+		}
+		if ( !held ) {
+			continue;
+		}
+		live.replicasOf(stableHash(it->first.data(), it->first.size()), par->REPLICATION, replicas);
+		unsigned int copies = 0;
+		for ( unsigned int r = 0; r < replicas.size(); r++ ) {
+			// Node ids are handed out by EmulNet starting at 1
+			int id = *(int *)replicas[r].nodeAddress.addr;
+			copies += mp2[id - 1]->hasKey(it->first);
+		}
+		if ( copies < replicas.size() ) {
+			sample.underReplicated++;
+		}
+	}
+	timeline.push_back(sample);
+}
+
+/**
+ * FUNCTION NAME: reportRingConvergence
+ *
+ * DESCRIPTION: Write the per tick samples to convergence.csv and print since when the
+ * 				rings agree and every key is fully replicated, and what stabilization
+ * 				moved over the run
+ */
+void Application::reportRingConvergence() {
+	FILE *file = fopen("convergence.csv", "w+");
+	fprintf(file, "time,live_nodes,ring_views,stale_nodes,under_replicated_keys,stabilization_bytes\n");
+	int agreedAt = -1, replicatedAt = -1;
+	for ( unsigned int t = 0; t < timeline.size(); t++ ) {
+		ConvergenceSample &sample = timeline[t];
+		fprintf(file, "%d,%d,%d,%d,%d,%ld\n", sample.time, sample.liveNodes, sample.ringViews, sample.staleNodes,
+				sample.underReplicated, sample.stabilizationBytes);
+		if ( sample.ringViews > 1 || sample.staleNodes > 0 ) {
+			agreedAt = -1;
+		}
+		else if ( agreedAt < 0 ) {
+			agreedAt = sample.time;
+		}
+		if ( sample.underReplicated > 0 ) {
+			replicatedAt = -1;
+		}
+		else if ( replicatedAt < 0 ) {
+			replicatedAt = sample.time;
+		}
+	}
+	fclose(file);
+
+	StabilizationStats total;
+	memset(&total, 0, sizeof(total));
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		total.runs += mp2[i]->stabStats.runs;
+		total.keysVisited += mp2[i]->stabStats.keysVisited;
+		total.replicasSent += mp2[i]->stabStats.replicasSent;
+		total.bytesSent += mp2[i]->stabStats.bytesSent;
+	}
+	cout<<"Ring convergence: rings agree on the live nodes since time "<<agreedAt<<", every key fully replicated since time "<<replicatedAt
+		<<" (-1 if not by the end), "<<total.runs<<" stabilization runs visited "<<total.keysVisited<<" keys and sent "
+		<<total.replicasSent<<" replicas, "<<total.bytesSent<<" bytes, timeline in convergence.csv"<<endl;
+}
+
+/**
+ * FUNCTION NAME: reportLoad
+ *
+ * DESCRIPTION: Dump the load of every live node to load.log: the keys of its hash table
+ * 				by replica type, the bytes they take and the client requests it served
+ * 				as a replica and coordinated. Print how evenly keys, primaries, bytes
+ * 				and served requests are spread as max/mean and coefficient of variation.
+ * 				Called every LOAD_REPORT periods and at the end of the run, load.log
+ * 				keeps every dump. Also print the successes and replies the requests
+ * 				that succeeded had when they closed, by type. With several zones, also print how many of the
+ * 				test keys the live nodes hold have copies in as many zones as they
+ * 				can, up to REPLICATION of the zones that have live nodes.
+ */
+void Application::reportLoad() {
+	FILE *file = fopen("load.log", loadLogged ? "a" : "w+");
+	loadLogged = true;
+	vector<double> keys, primaries, bytes, served;
+	vector<int> byReplica;
+	long reads = 0, readPeriods = 0;
+	long succeeded[DELETE + 1] = {0}, successes[DELETE + 1] = {0}, replies[DELETE + 1] = {0};
+
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		if ( mp2[i]->getMemberNode()->bFailed ) {
+			continue;
+		}
+		long stored;
+		mp2[i]->storedLoad(byReplica, stored);
+		LoadStats &load = mp2[i]->loadStats;
+		reads += load.reads;
+		readPeriods += load.readPeriods;
+		long requests = 0;
+		for ( int type = CREATE; type <= DELETE; type++ ) {
+			requests += load.served[type];
+			succeeded[type] += load.succeeded[type];
+			successes[type] += load.closingSuccesses[type];
+			replies[type] += load.closingReplies[type];
+		}
+		int held = 0;
+		fprintf(file, "time %3d node %3d keys by replica", par->getcurrtime(), i + 1);
+		for ( unsigned int r = 0; r < byReplica.size(); r++ ) {
+			fprintf(file, " %4d", byReplica[r]);
+			held += byReplica[r];
+		}
+		fprintf(file, " bytes %7ld served create %4ld read %4ld update %4ld delete %4ld coordinated %4ld\n", stored,
+				load.served[CREATE], load.served[READ], load.served[UPDATE], load.served[DELETE], load.coordinated);
+
+		keys.push_back(held);
+		primaries.push_back(byReplica.empty() ? 0 : byReplica[PRIMARY]);
+		bytes.push_back(stored);
+		served.push_back(requests);
+	}
+	fclose(file);
+
+	double cvKeys, cvPrimaries, cvBytes, cvServed;
+	double maxKeys = spread(keys, cvKeys);
+	double maxPrimaries = spread(primaries, cvPrimaries);
+	double maxBytes = spread(bytes, cvBytes);
+	double maxServed = spread(served, cvServed);
+	cout<<"Load at time "<<par->getcurrtime()<<" over "<<keys.size()<<" nodes (max/mean, cv): keys "<<maxKeys<<" "<<cvKeys
+		<<", primaries "<<maxPrimaries<<" "<<cvPrimaries<<", bytes "<<maxBytes<<" "<<cvBytes
+		<<", requests served "<<maxServed<<" "<<cvServed<<", "<<reads<<" reads took "
+		<<(reads > 0 ? (double)readPeriods / reads : 0)<<" periods on average, details in load.log"<<endl;
+
+	const char *modes[] = {"QUORUM", "ONE", "ALL", "LOCAL_QUORUM"};
+	const char *types[] = {"creates", "reads", "updates", "deletes"};
+	cout<<"Requests (reads "<<modes[par->READ_MODE]<<", writes "<<modes[par->WRITE_MODE]<<"), mean successes and replies at success:";
+	for ( int type = CREATE; type <= DELETE; type++ ) {
+		if ( succeeded[type] > 0 ) {
+			cout<<" "<<types[type]<<" "<<(double)successes[type] / succeeded[type]<<" "<<(double)replies[type] / succeeded[type];
+		}
+	}
+	cout<<endl;
+
+	if ( par->ZONES < 2 ) {
+		return;
+	}
+	int held = 0, spanning = 0;
+	set<int> liveZones;
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		if ( !mp2[i]->getMemberNode()->bFailed ) {
+			liveZones.insert(par->getZone(i + 1));
+		}
+	}
+	unsigned int wanted = min((int)liveZones.size(), par->REPLICATION);
+	for ( map<string, string>::iterator it = testKVPairs.begin(); it != testKVPairs.end(); ++it ) {
+		set<int> zones;
+		for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+			if ( !mp2[i]->getMemberNode()->bFailed && mp2[i]->hasKey(it->first) ) {
+				zones.insert(par->getZone(i + 1));
+			}
+		}
+		held += !zones.empty();
+		spanning += zones.size() >= wanted;
+	}
+	cout<<"Zones: "<<spanning<<" of "<<held<<" held test keys have copies in "<<wanted<<" zones, "<<liveZones.size()
+		<<" of the "<<par->ZONES<<" zones have live nodes"<<endl;
+}
+
+/**
+ * FUNCTION NAME: reportFailureDetector
+ *
+ * DESCRIPTION: Print the accuracy of the failure detector over the run.
+ * 				A removal is false if the removed node had not failed by then.
+ * 				Completeness is the share of (surviving node, failed node) pairs in
+ * 				which the survivor has dropped the failed node by the end of the run.
+ */
+void Application::reportFailureDetector() {
+	long suspicions = 0, refutations = 0;
+	int removals = 0, falseRemovals = 0;
+	long detectionTime = 0;
+
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		FailureDetectorStats &stats = mp1[i]->fdStats;
+		suspicions += stats.suspicions;
+		refutations += stats.refutations;
+		for ( unsigned int j = 0; j < stats.removals.size(); j++ ) {
+			// Node ids are handed out by EmulNet starting at 1
+			int removed = stats.removals[j].first - 1;
+			long when = stats.removals[j].second;
+			removals++;
+			if ( removed < 0 || removed >= par->EN_GPSZ || failTime[removed] < 0 || failTime[removed] > when ) {
+				falseRemovals++;
+			}
+			else {
+				detectionTime += when - failTime[removed];
+			}
+		}
+	}
+
+	cout<<endl<<"Failure detector: "<<suspicions<<" suspicions, "<<refutations<<" refutations, "
+		<<removals<<" removals of which "<<falseRemovals<<" false";
+	if ( removals > 0 ) {
+		cout<<" (false positive rate "<<(double)falseRemovals / removals<<")";
+	}
+	if ( removals > falseRemovals ) {
+		cout<<", mean detection time "<<(double)detectionTime / (removals - falseRemovals);
+	}
+
+	long pairs = 0, dropped = 0;
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		if ( failTime[i] >= 0 ) {
+			continue;
+		}
+		for ( int j = 0; j < par->EN_GPSZ; j++ ) {
+			if ( failTime[j] >= 0 ) {
+				pairs++;
+				if ( mp1[i]->getMemberNode()->memberList.find(j + 1) < 0 ) {
+					dropped++;
+				}
+			}
+		}
+	}
+	if ( pairs > 0 ) {
+		cout<<", completeness "<<(double)dropped / pairs;
+	}
+	cout<<endl;
+}
+
 /**
  * FUNCTION NAME: getjoinaddr
  *
@@ -517,7 +1008,7 @@ void Application::readTest() {
 		replicas.clear();
 		replicas = mp2[number]->findNodes(it->first);
 		// if less than quorum replicas are found then exit
-		if ( replicas.size() < (RF-1) ) {
+		if ( (int)replicas.size() < (par->REPLICATION-1) ) {
 			cout<<endl<<"Could not find at least quorum replicas for this key. Exiting!!! size of replicas vector: "<<replicas.size()<<endl;
 			log->LOG(&mp2[number]->getMemberNode()->addr, "Could not find at least quorum replicas for this key. Exiting!!! size of replicas vector: %d", replicas.size());
 			exit(1);
@@ -762,7 +1253,7 @@ void Application::updateTest() {
 		replicas.clear();
 		replicas = mp2[number]->findNodes(it->first);
 		// if quorum replicas are not found then exit
-		if ( replicas.size() < RF-1 ) {
+		if ( (int)replicas.size() < par->REPLICATION-1 ) {
 			log->LOG(&mp2[number]->getMemberNode()->addr, "Could not find at least quorum replicas for this key. Exiting!!! size of replicas vector: %d", replicas.size());
 			cout<<endl<<"Could not find at least quorum replicas for this key. Exiting!!! size of replicas vector: "<<replicas.size()<<endl;
 			exit(1);
@@ -962,3 +1453,119 @@ void Application::updateTest() {
 	/** end of test 5 **/
 
 }
+
+/**
+ * FUNCTION NAME: leaveTest
+ *
+ * DESCRIPTION: Take LEAVES nodes out one after the other, as in a rolling restart.
+ * 				With GRACEFUL_LEAVE the node hands its keys off and announces its departure,
+ * 				otherwise it just stops like the failure tests do.
+ */
+void Application::leaveTest() {
+	int alive = 0;
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		if ( !mp2[i]->getMemberNode()->bFailed ) {
+			alive++;
+		}
+	}
+
+	// Keep enough nodes for every key to have REPLICATION replicas
+	if ( (par->getcurrtime() - TEST_TIME) % LEAVE_INTERVAL == 0 && (int)departures.size() < par->LEAVES && alive > par->REPLICATION ) {
+		int number = findARandomNodeThatIsAlive();
+		if ( par->GRACEFUL_LEAVE ) {
+			log->LOG(&mp2[number]->getMemberNode()->addr, "Node left at time=%d", par->getcurrtime());
+			mp2[number]->handOffKeys();
+			mp1[number]->leaveGroup();
+		}
+		else {
+			log->LOG(&mp2[number]->getMemberNode()->addr, "Node failed at time=%d", par->getcurrtime());
+		}
+		mp2[number]->getMemberNode()->bFailed = true;
+		mp1[number]->getMemberNode()->bFailed = true;
+
+		Departure departure;
+		departure.node = number;
+		departure.time = par->getcurrtime();
+		departure.forgottenAt = -1;
+		departure.repairedAt = -1;
+		departures.push_back(departure);
+		cout<<endl<<(par->GRACEFUL_LEAVE ? "Node left" : "Node failed")<<" at time "<<par->getcurrtime()<<endl;
+	}
+
+	recordDepartures();
+}
+
+/**
+ * FUNCTION NAME: recordDepartures
+ *
+ * DESCRIPTION: Note when each departed node is gone from every live membership list
+ * 				and when every test key has REPLICATION live copies again
+ */
+void Application::recordDepartures() {
+	bool repaired = true;
+	for ( map<string, string>::iterator it = testKVPairs.begin(); it != testKVPairs.end() && repaired; ++it ) {
+		int copies = 0;
+		for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+			if ( !mp2[i]->getMemberNode()->bFailed && mp2[i]->hasKey(it->first) ) {
+				copies++;
+			}
+		}
+		repaired = copies >= par->REPLICATION;
+	}
+
+	for ( unsigned int d = 0; d < departures.size(); d++ ) {
+		Departure &departure = departures[d];
+		// Node ids are handed out by EmulNet starting at 1
+		int id = departure.node + 1;
+
+		if ( departure.forgottenAt < 0 ) {
+			bool listed = false;
+			for ( int i = 0; i < par->EN_GPSZ && !listed; i++ ) {
+				Member *memberNode = mp1[i]->getMemberNode();
+				if ( memberNode->bFailed ) {
+					continue;
+				}
+				for ( unsigned int j = 0; j < memberNode->memberList.size(); j++ ) {
+					if ( memberNode->memberList[j].getid() == id ) {
+						listed = true;
+						break;
+					}
+				}
+			}
+			if ( !listed ) {
+				departure.forgottenAt = par->getcurrtime();
+			}
+		}
+		if ( departure.repairedAt < 0 && repaired ) {
+			departure.repairedAt = par->getcurrtime();
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: reportDepartures
+ *
+ * DESCRIPTION: Print how long the cluster took to absorb each departure of the leave test
+ */
+void Application::reportDepartures() {
+	cout<<endl<<"Leave test ("<<(par->GRACEFUL_LEAVE ? "graceful" : "crash")<<"): ";
+	cout<<departures.size()<<" departures";
+	for ( unsigned int d = 0; d < departures.size(); d++ ) {
+		Departure &departure = departures[d];
+		cout<<endl<<"  node "<<departure.node + 1<<" left at time "<<departure.time<<": dropped by every member after ";
+		if ( departure.forgottenAt >= 0 ) {
+			cout<<departure.forgottenAt - departure.time;
+		}
+		else {
+			cout<<"never";
+		}
+		cout<<", all keys back to "<<par->REPLICATION<<" copies after ";
+		if ( departure.repairedAt >= 0 ) {
+			cout<<departure.repairedAt - departure.time;
+		}
+		else {
+			cout<<"never";
+		}
+	}
+	cout<<endl;
+}
@@ -37,9 +37,43 @@ static const char alphanum[] =
 #define STABILIZE_TIME 50
 #define FIRST_FAIL_TIME 25
 #define LAST_FAIL_TIME 10
-#define RF 3
 #define NUMBER_OF_INSERTS 100
 #define KEY_LENGTH 5
+// periods between two nodes leaving in the leave test
+#define LEAVE_INTERVAL 50
+// key space positions sampled by the ring balance report
+#define BALANCE_SAMPLES 65536
+
+/**
+ * STRUCT NAME: Departure
+ *
+ * DESCRIPTION: A node taken out by the leave test and how long the rest took to recover
+ */
+typedef struct Departure {
+	int node;
+	int time;
+	// first time no live member listed it, -1 until then
+	int forgottenAt;
+	// first time every test key had REPLICATION live copies again, -1 until then
+	int repairedAt;
+} Departure;
+
+/**
+ * STRUCT NAME: ConvergenceSample
+ *
+ * DESCRIPTION: The state of the KV store rings and replicas at the end of a tick
+ */
+typedef struct ConvergenceSample {
+	int time;
+	int liveNodes;
+	// distinct rings held by the live nodes, and live nodes whose ring does not list exactly the live nodes
+	int ringViews;
+	int staleNodes;
+	// keys some live node holds with fewer than REPLICATION copies on the replicas of the live nodes ring
+	int underReplicated;
+	// bytes of replicas pushed by stabilization and hand-off during the tick
+	long stabilizationBytes;
+} ConvergenceSample;
 
 /**
  * CLASS NAME: Application
@@ -58,6 +92,17 @@ private:
 	MP2Node **mp2;
 	Params *par;
 	map<string, string> testKVPairs;
+	// time at which each node was failed, -1 while it is up
+	vector<int> failTime;
+	// first time every node knew about every other node, -1 until then
+	int convergedAt;
+	// nodes taken out by the leave test
+	vector<Departure> departures;
+	// per tick state of the KV store, written to convergence.csv
+	vector<ConvergenceSample> timeline;
+	long stabilizationBytes;
+	// load.log was started by an earlier dump
+	bool loadLogged;
 public:
 	Application(char *);
 	virtual ~Application();
@@ -72,6 +117,18 @@ public:
 	void deleteTest();
 	void readTest();
 	void updateTest();
+	void leaveTest();
+	void recordDepartures();
+	void reportDepartures();
+	void recordFailures();
+	void reportFailureDetector();
+	void recordConvergence();
+	void reportGossip();
+	void reportMemory();
+	void reportRingBalance();
+	void recordRingConvergence();
+	void reportRingConvergence();
+	void reportLoad();
 };
 
 #endif /* _APPLICATION_H__ */
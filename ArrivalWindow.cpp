@@ -0,0 +1,69 @@
+/**********************************
+ * FILE NAME: ArrivalWindow.cpp
+ *
+ * DESCRIPTION: Definition of the ArrivalWindow class
+ **********************************/
+
+#include "ArrivalWindow.h"
+
+/**
+ * Constructor
+ */
+ArrivalWindow::ArrivalWindow(): head(0), count(0), sum(0), sumSquares(0), lastArrival(0), suspectedAt(-1) {}
+
+/**
+ * Constructor
+ */
+ArrivalWindow::ArrivalWindow(long now): head(0), count(0), sum(0), sumSquares(0), lastArrival(now), suspectedAt(-1) {}
+
+/**
+ * FUNCTION NAME: record
+ *
+ * DESCRIPTION: Record a heartbeat arriving now, evicting the oldest interval if the window is full
+ */
+void ArrivalWindow::record(long now) {
+	int interval = (int)min(now - lastArrival, 255L);
+	lastArrival = now;
+
+	if ( count == PHI_WINDOW ) {
+		sum -= intervals[head];
+		sumSquares -= intervals[head] * intervals[head];
+	}
+	else {
+		count++;
+	}
+	intervals[head] = (unsigned char)interval;
+	sum += interval;
+	sumSquares += interval * interval;
+	head = (head + 1) % PHI_WINDOW;
+}
+
+/**
+ * FUNCTION NAME: hasHistory
+ *
+ * DESCRIPTION: Returns true once there are enough intervals to estimate a deviation
+ */
+bool ArrivalWindow::hasHistory() {
+	return count >= 2;
+}
+
+/**
+ * FUNCTION NAME: phi
+ *
+ * DESCRIPTION: Suspicion level -log10(P(no heartbeat for this long | member alive)), with the
+ * 				inter-arrival times taken as normally distributed. Uses the logistic
+ * 				approximation of the normal CDF, which stays finite far into the tail.
+ */
+double ArrivalWindow::phi(long now) {
+	double mean = (double)sum / count;
+	double variance = (double)sumSquares / count - mean * mean;
+	double stddev = max(sqrt(max(variance, 0.0)), PHI_MIN_STDDEV);
+	double elapsed = now - lastArrival;
+	double y = (elapsed - mean) / stddev;
+	double e = exp(-y * (1.5976 + 0.070566 * y * y));
+
+	if ( elapsed > mean ) {
+		return -log10(e / (1.0 + e));
+	}
+	return -log10(1.0 - 1.0 / (1.0 + e));
+}
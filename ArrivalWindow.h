@@ -0,0 +1,47 @@
+/**********************************
+ * FILE NAME: ArrivalWindow.h
+ *
+ * DESCRIPTION: Header file of the ArrivalWindow class used by the phi accrual failure detector
+ **********************************/
+
+#ifndef ARRIVALWINDOW_H_
+#define ARRIVALWINDOW_H_
+
+#include "stdincludes.h"
+
+/*
+ * Macros
+ */
+// number of heartbeat inter-arrival times remembered per member
+#define PHI_WINDOW 32
+// floor on the standard deviation, in periods, so a perfectly regular member isn't suspected after one late beat
+#define PHI_MIN_STDDEV 0.5
+
+/**
+ * CLASS NAME: ArrivalWindow
+ *
+ * DESCRIPTION: Sliding window of the last PHI_WINDOW heartbeat inter-arrival times of a
+ * 				member, kept in a ring buffer of one byte per interval. phi() gives the
+ * 				suspicion level for the time elapsed since the last heartbeat.
+ */
+class ArrivalWindow {
+public:
+	// inter-arrival times in periods, clamped to 255
+	unsigned char intervals[PHI_WINDOW];
+	int head;
+	int count;
+	// running sums over the window
+	int sum;
+	int sumSquares;
+	long lastArrival;
+	// time this member was last marked suspect, -1 if never
+	long suspectedAt;
+
+	ArrivalWindow();
+	ArrivalWindow(long now);
+	void record(long now);
+	bool hasHistory();
+	double phi(long now);
+};
+
+#endif /* ARRIVALWINDOW_H_ */
@@ -0,0 +1,395 @@
+/**********************************
+ * FILE NAME: Bench.cpp
+ *
+ * DESCRIPTION: Micro benchmarks of the hot paths of the simulator.
+ * 				Build with "make bench", run "./Bench" for all of them or
+ * 				"./Bench <name>" for one.
+ **********************************/
+
+#include "stdincludes.h"
+#include "Member.h"
+#include "MP1Message.h"
+#include "Ring.h"
+
+/*
+ * Macros
+ */
+#define SCAN_MEMBERS 10000
+#define SCAN_ROUNDS 20000
+// Members of the scan benchmark that went quiet, the rest heartbeat every period
+#define SCAN_SILENT 10
+#define SCAN_TFAIL 5
+#define LOOKUP_KEYS 1000000
+#define PLACEMENT_NODES 100
+#define PLACEMENT_REPLICAS 3
+// keys per findNodesBatch call of the batch benchmark
+#define BATCH_KEYS 1000
+#define WIRE_MEMBERS 1000
+#define WIRE_ROUNDS 1000
+
+/**
+ * FUNCTION NAME: nowNanos
+ *
+ * DESCRIPTION: Monotonic clock in nanoseconds
+ */
+static double nowNanos() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * FUNCTION NAME: benchScan
+ *
+ * DESCRIPTION: Per period timeout scan of a SCAN_MEMBERS table: the former walk over
+ * 				vector<MemberListEntry> against MemberTable::updatedBefore
+ */
+static void benchScan() {
+	int now = 1000;
+	vector<MemberListEntry> entries;
+	MemberTable table;
+	for ( int i = 0; i < SCAN_MEMBERS; i++ ) {
+		long timestamp = now - rand() % SCAN_TFAIL;
+		if ( i % (SCAN_MEMBERS / SCAN_SILENT) == 0 ) {
+			timestamp = now - SCAN_TFAIL - 1 - rand() % 20;
+		}
+		MemberListEntry entry(i + 1, 0, rand(), timestamp);
+		entries.push_back(entry);
+		table.insert(entry);
+	}
+
+	long found = 0;
+	double start = nowNanos();
+	for ( int round = 0; round < SCAN_ROUNDS; round++ ) {
+		for ( unsigned int i = 0; i < entries.size(); i++ ) {
+			if ( now - entries[i].timestamp > SCAN_TFAIL ) {
+				found++;
+			}
+		}
+	}
+	double structs = (nowNanos() - start) / SCAN_ROUNDS;
+
+	vector<unsigned int> rows;
+	start = nowNanos();
+	for ( int round = 0; round < SCAN_ROUNDS; round++ ) {
+		table.updatedBefore(now - SCAN_TFAIL, rows);
+		found -= rows.size();
+	}
+	double columns = (nowNanos() - start) / SCAN_ROUNDS;
+
+	printf("scan: %d members, %d silent\n", SCAN_MEMBERS, SCAN_SILENT);
+	printf("  vector<MemberListEntry>     %10.0f ns per scan\n", structs);
+	printf("  MemberTable::updatedBefore  %10.0f ns per scan (%.1fx)\n", columns, structs / columns);
+	if ( found != 0 ) {
+		printf("  MISMATCH between the two scans\n");
+	}
+}
+
+/**
+ * FUNCTION NAME: benchAddress
+ *
+ * DESCRIPTION: Address EmulNet gives the node with the given id
+ */
+static Address benchAddress(int id) {
+	Address addr;
+	short port = 0;
+	memcpy(&addr.addr[0], &id, sizeof(int));
+	memcpy(&addr.addr[4], &port, sizeof(short));
+	return addr;
+}
+
+/**
+ * FUNCTION NAME: keyPositions
+ *
+ * DESCRIPTION: Ring positions of LOOKUP_KEYS keys, hashed as MP2Node::hashFunction does
+ */
+static vector<size_t> keyPositions() {
+	vector<size_t> positions(LOOKUP_KEYS);
+	for ( int k = 0; k < LOOKUP_KEYS; k++ ) {
+		string key = "key" + to_string(k);
+		positions[k] = stableHash(key.data(), key.size());
+	}
+	return positions;
+}
+
+/**
+ * FUNCTION NAME: linearOwner
+ *
+ * DESCRIPTION: The former findNodes walk, kept as the baseline of benchRing
+ */
+static unsigned int linearOwner(vector<Node> &ring, size_t pos) {
+	if ( pos <= ring[0].nodeHashCode || pos > ring[ring.size()-1].nodeHashCode ) {
+		return 0;
+	}
+	for ( unsigned int i = 1; i < ring.size(); i++ ) {
+		if ( pos <= ring[i].nodeHashCode ) {
+			return i;
+		}
+	}
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: searchOwner
+ *
+ * DESCRIPTION: Binary search for the first node at or after a ring position, the
+ * 				lookup Ring used before its slot table
+ */
+static unsigned int searchOwner(vector<Node> &ring, size_t pos) {
+	unsigned int low = 0, high = ring.size();
+	while ( low < high ) {
+		unsigned int mid = (low + high) / 2;
+		if ( ring[mid].nodeHashCode < pos ) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	// Past the last node the ring wraps around to the first one
+	return low == ring.size() ? 0 : low;
+}
+
+/**
+ * FUNCTION NAME: benchRing
+ *
+ * DESCRIPTION: LOOKUP_KEYS owner lookups on rings of several sizes: the former linear
+ * 				walk and binary search against Ring's slot table
+ */
+static void benchRing() {
+	int sizes[] = {10, 100, 500};
+	vector<size_t> positions = keyPositions();
+
+	printf("ring: %d lookups, %lu bytes per ring entry (%lu per Node)\n", LOOKUP_KEYS, sizeof(RingEntry), sizeof(Node));
+	for ( unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++ ) {
+		vector<Node> members;
+		for ( int id = 1; id <= sizes[s]; id++ ) {
+			members.push_back(Node(benchAddress(id)));
+		}
+		Ring ring;
+		ring.assign(members);
+		sort(members.begin(), members.end());
+		// Build the slot table outside of the timed loop, as the first findNodes after a change does
+		ring.ownerOf(0);
+
+		unsigned long check = 0;
+		double start = nowNanos();
+		for ( int k = 0; k < LOOKUP_KEYS; k++ ) {
+			check += linearOwner(members, positions[k]);
+		}
+		double linear = (nowNanos() - start) / LOOKUP_KEYS;
+
+		start = nowNanos();
+		for ( int k = 0; k < LOOKUP_KEYS; k++ ) {
+			check -= searchOwner(members, positions[k]);
+		}
+		double search = (nowNanos() - start) / LOOKUP_KEYS;
+
+		start = nowNanos();
+		for ( int k = 0; k < LOOKUP_KEYS; k++ ) {
+			check += ring.ownerOf(positions[k]);
+		}
+		double table = (nowNanos() - start) / LOOKUP_KEYS;
+		for ( int k = 0; k < LOOKUP_KEYS; k++ ) {
+			check -= linearOwner(members, positions[k]);
+		}
+
+		printf("  %3d nodes: linear %6.1f ns, binary search %6.1f ns (%.1fx), slot table %6.1f ns (%.1fx)\n",
+				sizes[s], linear, search, linear / search, table, linear / table);
+		if ( check != 0 ) {
+			printf("  MISMATCH between the lookups\n");
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: movedKeys
+ *
+ * DESCRIPTION: Share of the keys whose primary, and whose replica set, differ between
+ * 				two rings
+ */
+static void movedKeys(Ring &before, Ring &after, vector<size_t> &positions, double &primaries, double &replicas) {
+	vector<Node> from, to;
+	long primaryMoves = 0, replicaMoves = 0;
+	for ( unsigned int k = 0; k < positions.size(); k++ ) {
+		before.replicasOf(positions[k], PLACEMENT_REPLICAS, from);
+		after.replicasOf(positions[k], PLACEMENT_REPLICAS, to);
+		if ( !(*from[0].getAddress() == *to[0].getAddress()) ) {
+			primaryMoves++;
+		}
+		for ( unsigned int i = 0; i < from.size(); i++ ) {
+			bool kept = false;
+			for ( unsigned int j = 0; j < to.size() && !kept; j++ ) {
+				kept = *from[i].getAddress() == *to[j].getAddress();
+			}
+			if ( !kept ) {
+				replicaMoves++;
+				break;
+			}
+		}
+	}
+	primaries = (double)primaryMoves / positions.size();
+	replicas = (double)replicaMoves / positions.size();
+}
+
+/**
+ * FUNCTION NAME: benchPlacement
+ *
+ * DESCRIPTION: The placement strategies on PLACEMENT_NODES nodes: time of a lookup of
+ * 				PLACEMENT_REPLICAS replicas, and keys that move when a node joins and
+ * 				when a node from the middle of the id range leaves. The ideal move is
+ * 				1/n of the primaries.
+ */
+static void benchPlacement() {
+	const char *names[] = {"ring", "rendezvous", "jump"};
+	int strategies[] = {RING_PLACEMENT, RENDEZVOUS_PLACEMENT, JUMP_PLACEMENT};
+	vector<size_t> positions = keyPositions();
+	Address joiner = benchAddress(PLACEMENT_NODES + 1);
+	Address leaver = benchAddress(PLACEMENT_NODES / 2);
+
+	printf("placement: %d nodes, %d replicas, %d keys, ideal move %.4f on join, %.4f on leave\n",
+			PLACEMENT_NODES, PLACEMENT_REPLICAS, LOOKUP_KEYS, 1.0 / (PLACEMENT_NODES + 1), 1.0 / PLACEMENT_NODES);
+	for ( unsigned int s = 0; s < sizeof(strategies) / sizeof(strategies[0]); s++ ) {
+		Ring ring, joined, left;
+		ring.setPlacement(strategies[s]);
+		joined.setPlacement(strategies[s]);
+		left.setPlacement(strategies[s]);
+		for ( int id = 1; id <= PLACEMENT_NODES; id++ ) {
+			Address addr = benchAddress(id);
+			ring.insertMember(addr, 1);
+			joined.insertMember(addr, 1);
+			left.insertMember(addr, 1);
+		}
+		joined.insertMember(joiner, 1);
+		left.eraseMember(leaver, 1);
+
+		vector<Node> replicas;
+		unsigned long check = 0;
+		double start = nowNanos();
+		for ( int k = 0; k < LOOKUP_KEYS; k++ ) {
+			ring.replicasOf(positions[k], PLACEMENT_REPLICAS, replicas);
+			check += replicas.size();
+		}
+		double lookup = (nowNanos() - start) / LOOKUP_KEYS;
+
+		double joinPrimaries, joinReplicas, leavePrimaries, leaveReplicas;
+		movedKeys(ring, joined, positions, joinPrimaries, joinReplicas);
+		movedKeys(ring, left, positions, leavePrimaries, leaveReplicas);
+		printf("  %-10s %6.1f ns per lookup, join moves %.4f primaries %.4f replica sets, leave moves %.4f primaries %.4f replica sets\n",
+				names[s], lookup, joinPrimaries, joinReplicas, leavePrimaries, leaveReplicas);
+		if ( check != (unsigned long)LOOKUP_KEYS * PLACEMENT_REPLICAS ) {
+			printf("  SHORT replica sets\n");
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: benchBatch
+ *
+ * DESCRIPTION: Replica lookups of LOOKUP_KEYS keys on rings of several sizes, key by key
+ * 				as findNodes does against batches of BATCH_KEYS as findNodesBatch does
+ */
+static void benchBatch() {
+	int sizes[] = {10, 100, 1000};
+	vector<size_t> positions = keyPositions();
+
+	printf("batch: %d keys, %d replicas, batches of %d\n", LOOKUP_KEYS, PLACEMENT_REPLICAS, BATCH_KEYS);
+	for ( unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++ ) {
+		Ring ring;
+		for ( int id = 1; id <= sizes[s]; id++ ) {
+			Address addr = benchAddress(id);
+			ring.insertMember(addr, 1);
+		}
+		ring.ownerOf(0);
+
+		vector<Node> replicas;
+		unsigned long check = 0;
+		double start = nowNanos();
+		for ( int k = 0; k < LOOKUP_KEYS; k++ ) {
+			ring.replicasOf(positions[k], PLACEMENT_REPLICAS, replicas);
+			check += replicas[0].nodeHashCode;
+		}
+		double single = (nowNanos() - start) / LOOKUP_KEYS;
+
+		vector<size_t> batch;
+		vector<unsigned int> setOf;
+		unsigned int count = ring.setSize(PLACEMENT_REPLICAS);
+		start = nowNanos();
+		for ( int first = 0; first < LOOKUP_KEYS; first += BATCH_KEYS ) {
+			batch.assign(positions.begin() + first, positions.begin() + min(first + BATCH_KEYS, LOOKUP_KEYS));
+			ring.replicasOfMany(batch, PLACEMENT_REPLICAS, setOf, replicas);
+			for ( unsigned int k = 0; k < setOf.size(); k++ ) {
+				check -= replicas[setOf[k] * count].nodeHashCode;
+			}
+		}
+		double batched = (nowNanos() - start) / LOOKUP_KEYS;
+
+		printf("  %4d nodes: one by one %6.1f ns per key, batched %6.1f ns per key (%.1fx)\n",
+				sizes[s], single, batched, single / batched);
+		if ( check != 0 ) {
+			printf("  MISMATCH between the lookups\n");
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: benchWire
+ *
+ * DESCRIPTION: Size and encode/decode time of a GOSSIP carrying WIRE_MEMBERS entries
+ * 				as the gossip of a converged group looks: ids 1 to WIRE_MEMBERS, port 0,
+ * 				heartbeats within a few periods of each other
+ */
+static void benchWire() {
+	MP1Message message(GOSSIP, 1, 0, 500);
+	for ( int i = 1; i <= WIRE_MEMBERS; i++ ) {
+		message.entries.push_back(MemberListEntry(i, 0, 500 - rand() % 10, 0));
+	}
+	string data = message.encode();
+
+	MP1Message decoded;
+	bool ok = true;
+	double start = nowNanos();
+	for ( int round = 0; round < WIRE_ROUNDS; round++ ) {
+		data = message.encode();
+	}
+	double encoding = (nowNanos() - start) / WIRE_ROUNDS;
+	start = nowNanos();
+	for ( int round = 0; round < WIRE_ROUNDS; round++ ) {
+		ok = decoded.decode((char *)data.data(), data.size()) && ok;
+	}
+	double decoding = (nowNanos() - start) / WIRE_ROUNDS;
+	ok = ok && decoded.entries.size() == message.entries.size();
+
+	printf("wire: GOSSIP of %d members is %lu bytes (%.2f per member), encode %.1f us, decode %.1f us\n",
+			WIRE_MEMBERS, data.size(), (double)data.size() / WIRE_MEMBERS, encoding / 1000, decoding / 1000);
+	if ( !ok ) {
+		printf("  DECODE FAILED\n");
+	}
+}
+
+/**********************************
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: Run the benchmark named on the command line, all of them by default
+ **********************************/
+int main(int argc, char *argv[]) {
+	string which = argc > 1 ? argv[1] : "all";
+	srand(1);
+
+	if ( which == "all" || which == "scan" ) {
+		benchScan();
+	}
+	if ( which == "all" || which == "ring" ) {
+		benchRing();
+	}
+	if ( which == "all" || which == "placement" ) {
+		benchPlacement();
+	}
+	if ( which == "all" || which == "batch" ) {
+		benchBatch();
+	}
+	if ( which == "all" || which == "wire" ) {
+		benchWire();
+	}
+	return 0;
+}
@@ -17,6 +17,8 @@ EmulNet::EmulNet(Params *p)
 	emulnet.setNextId(1);
 	emulnet.settCurrBuffSize(0);
 	enInited=0;
+	sentBytes = 0;
+	crossZoneBytes = 0;
 	for ( i = 0; i < MAX_NODES; i++ ) {
 		for ( j = 0; j < MAX_TIME; j++ ) {
 			sent_msgs[i][j] = 0;
@@ -33,6 +35,8 @@ EmulNet::EmulNet(EmulNet &anotherEmulNet) {
 	int i, j;
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
+	this->sentBytes = anotherEmulNet.sentBytes;
+	this->crossZoneBytes = anotherEmulNet.crossZoneBytes;
 	for ( i = 0; i < MAX_NODES; i++ ) {
 		for ( j = 0; j < MAX_TIME; j++ ) {
 			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
@@ -49,6 +53,8 @@ EmulNet& EmulNet::operator =(EmulNet &anotherEmulNet) {
 	int i, j;
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
+	this->sentBytes = anotherEmulNet.sentBytes;
+	this->crossZoneBytes = anotherEmulNet.crossZoneBytes;
 	for ( i = 0; i < MAX_NODES; i++ ) {
 		for ( j = 0; j < MAX_TIME; j++ ) {
 			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
@@ -104,11 +110,17 @@ int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
 
 	int src = *(int *)(myaddr->addr);
 	int time = par->getcurrtime();
+	// Messages between zones wait out the latency of the link
+	em->deliverAt = time + par->getLatency(src, *(int *)(toaddr->addr));
 
 	assert(src <= MAX_NODES);
 	assert(time < MAX_TIME);
 
 	sent_msgs[src][time]++;
+	sentBytes += size;
+	if ( par->getZone(src) != par->getZone(*(int *)(toaddr->addr)) ) {
+		crossZoneBytes += size;
+	}
 
 	#ifdef DEBUGLOG
 		sprintf(temp, "Sending 4+%d B msg type %d to %d.%d.%d.%d:%d ", size-4, *(int *)data, toaddr->addr[0], toaddr->addr[1], toaddr->addr[2], toaddr->addr[3], *(short *)&toaddr->addr[4]);
@@ -136,7 +148,7 @@ int EmulNet::ENsend(Address *myaddr, Address *toaddr, string data) {
 /**
  * FUNCTION NAME: ENrecv
  *
- * DESCRIPTION: EmulNet receive function
+ * DESCRIPTION: EmulNet receive function, messages still on a slow link stay queued
  *
  * RETURN:
  * 0
@@ -151,7 +163,8 @@ int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct ti
 	for( i = emulnet.currbuffsize - 1; i >= 0; i-- ) {
 		emsg = emulnet.buff[i];
 
-		if ( 0 == strcmp(emsg->to.addr, myaddr->addr) ) {
+		// Compare the raw 6 bytes, ids from 256 up have NUL bytes in them
+		if ( 0 == memcmp(emsg->to.addr, myaddr->addr, sizeof(myaddr->addr)) && emsg->deliverAt <= par->getcurrtime() ) {
 			sz = emsg->size;
 			tmp = (char *) malloc(sz * sizeof(char));
 			memcpy(tmp, (char *)(emsg+1), sz);
@@ -214,7 +227,26 @@ int EmulNet::ENcleanup() {
 		fprintf(file, "\n");
 		fprintf(file, "node %3d sent_total %6u  recv_total %6u\n\n", i, sent_total, recv_total);
 	}
+	fprintf(file, "sent_bytes %ld  cross_zone_bytes %ld\n", sentBytes, crossZoneBytes);
 
 	fclose(file);
 	return 0;
 }
+
+/**
+ * FUNCTION NAME: getSentBytes
+ *
+ * DESCRIPTION: Return the payload bytes sent so far
+ */
+long EmulNet::getSentBytes() {
+	return sentBytes;
+}
+
+/**
+ * FUNCTION NAME: getCrossZoneBytes
+ *
+ * DESCRIPTION: Return the payload bytes sent so far between nodes of different zones
+ */
+long EmulNet::getCrossZoneBytes() {
+	return crossZoneBytes;
+}
@@ -27,6 +27,8 @@ typedef struct en_msg {
 	Address from;
 	// Destination node
 	Address to;
+	// time from which the destination may receive it
+	int deliverAt;
 }en_msg;
 
 /**
@@ -84,6 +86,9 @@ private:
 	int recv_msgs[MAX_NODES + 1][MAX_TIME];
 	int enInited;
 	EM emulnet;
+	// payload bytes accepted by ENsend, in total and between different zones
+	long sentBytes;
+	long crossZoneBytes;
 public:
  	EmulNet(Params *p);
  	EmulNet(EmulNet &anotherEmulNet);
@@ -94,6 +99,8 @@ public:
 	int ENsend(Address *myaddr, Address *toaddr, char *data, int size);
 	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
 	int ENcleanup();
+	long getSentBytes();
+	long getCrossZoneBytes();
 };
 
 #endif /* _EMULNET_H_ */
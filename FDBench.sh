@@ -0,0 +1,73 @@
+#!/bin/bash
+
+#################################################
+# FILE NAME: FDBench.sh
+#
+# DESCRIPTION: Failure detector benchmark. Runs the membership protocol over a
+#              grid of cluster sizes, message drop rates, failure patterns and
+#              failure detectors and writes one CSV row per run.
+#
+# RUN PROCEDURE:
+# $ make fdbench
+# or, after make, with any of the grid variables below overridden:
+# $ SIZES="10 50" DROPS="0 0.2" RUNS=3 ./FDBench.sh
+#
+# Failure patterns are the ones of Application::fail: "single" fails one
+# node at time 100, "multi" fails half of them. Messages are dropped with the
+# given probability from time 50 to 300.
+#################################################
+
+###
+# Global variables
+###
+SIZES=${SIZES:-"10 20 50"}
+DROPS=${DROPS:-"0 0.1 0.2"}
+PATTERNS=${PATTERNS:-"single multi"}
+DETECTORS=${DETECTORS:-"TIMEOUT PHI"}
+RUNS=${RUNS:-1}
+OUTPUT=${OUTPUT:-fdbench.csv}
+
+if [ ! -x ./Application ]; then
+	echo "Build the Application first: make"
+	exit 1
+fi
+
+CONF=$(mktemp)
+trap 'rm -f ${CONF}' EXIT
+
+# Print the number following the given text in the report, empty if it is missing
+function field () {
+	echo "$2" | grep -o "$1 [0-9.e+-]*" | head -1 | awk '{print $NF}'
+}
+
+echo "nodes,drop_prob,pattern,detector,run,converged_at,removals,false_removals,detection_time,completeness,bytes_per_node_per_tick" > ${OUTPUT}
+
+for size in ${SIZES}; do
+	for drop in ${DROPS}; do
+		for pattern in ${PATTERNS}; do
+			for detector in ${DETECTORS}; do
+				for run in $(seq 1 ${RUNS}); do
+					{
+						echo "MAX_NNB: ${size}"
+						echo "SINGLE_FAILURE: $([ "${pattern}" == "single" ] && echo 1 || echo 0)"
+						echo "DROP_MSG: $([ "${drop}" == "0" ] && echo 0 || echo 1)"
+						echo "MSG_DROP_PROB: ${drop}"
+						echo "FAILURE_DETECTOR: ${detector}"
+					} > ${CONF}
+					report=$(./Application ${CONF})
+					gossip=$(echo "${report}" | grep "^Gossip")
+					detector_line=$(echo "${report}" | grep "^Failure detector")
+					converged=$(field "converged at time" "${gossip}")
+					removals=$(echo "${detector_line}" | grep -o "[0-9]* removals" | awk '{print $1}')
+					falseRemovals=$(field "of which" "${detector_line}")
+					detection=$(field "mean detection time" "${detector_line}")
+					completeness=$(field "completeness" "${detector_line}")
+					bytes=$(echo "${gossip}" | grep -o "[0-9.e+-]* bytes per node per tick" | awk '{print $1}')
+					echo "${size},${drop},${pattern},${detector},${run},${converged},${removals},${falseRemovals},${detection},${completeness},${bytes}" | tee -a ${OUTPUT}
+				done
+			done
+		done
+	done
+done
+
+echo "Results in ${OUTPUT}"
@@ -0,0 +1,263 @@
+/**********************************
+ * FILE NAME: MP1Message.cpp
+ *
+ * DESCRIPTION: Wire format of the membership protocol messages
+ **********************************/
+
+#include "MP1Message.h"
+
+/**
+ * Varint helpers
+ */
+static void putVarint(string &out, unsigned long value) {
+	while ( value >= 0x80 ) {
+		out.push_back((char)((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+	out.push_back((char)value);
+}
+
+static bool getVarint(const unsigned char *&ptr, const unsigned char *end, unsigned long &value) {
+	int shift = 0;
+	value = 0;
+	while ( ptr < end && shift < 64 ) {
+		unsigned char byte = *ptr++;
+		value |= (unsigned long)(byte & 0x7f) << shift;
+		if ( !(byte & 0x80) ) {
+			return true;
+		}
+		shift += 7;
+	}
+	return false;
+}
+
+static void putFixed64(string &out, unsigned long value) {
+	for ( int i = 0; i < 8; i++ ) {
+		out.push_back((char)(value >> (8 * i)));
+	}
+}
+
+static bool getFixed64(const unsigned char *&ptr, const unsigned char *end, unsigned long &value) {
+	if ( end - ptr < 8 ) {
+		return false;
+	}
+	value = 0;
+	for ( int i = 0; i < 8; i++ ) {
+		value |= (unsigned long)*ptr++ << (8 * i);
+	}
+	return true;
+}
+
+static unsigned long zigzag(long value) {
+	return ((unsigned long)value << 1) ^ (unsigned long)(value >> 63);
+}
+
+static long unzigzag(unsigned long value) {
+	return (long)(value >> 1) ^ -(long)(value & 1);
+}
+
+static bool compareById(const MemberListEntry &a, const MemberListEntry &b) {
+	return a.id < b.id;
+}
+
+/**
+ * Constructor
+ */
+MP1Message::MP1Message(): msgType(DUMMYLASTMSGTYPE), id(0), port(0), heartbeat(0), chunk(0), chunks(1), stage(DIGEST_ROOT), digest(0) {}
+
+/**
+ * Constructor
+ */
+MP1Message::MP1Message(MsgTypes msgType, int id, short port, long heartbeat): msgType(msgType), id(id), port(port), heartbeat(heartbeat), chunk(0), chunks(1), stage(DIGEST_ROOT), digest(0) {}
+
+/**
+ * FUNCTION NAME: hasEntries
+ *
+ * DESCRIPTION: Returns true if this message type carries a membership list
+ */
+bool MP1Message::hasEntries() {
+	return msgType == JOINREP || msgType == GOSSIP;
+}
+
+/**
+ * FUNCTION NAME: encodeEntry
+ *
+ * DESCRIPTION: Append one list entry, delta-encoded against the previous entry of the message
+ */
+static void encodeEntry(string &out, MemberListEntry &entry, MemberListEntry &prev, unsigned char flags) {
+	putVarint(out, (unsigned int)(entry.id - prev.id));
+	if ( !(flags & MP1_FLAG_NOPORTS) ) {
+		putVarint(out, zigzag(entry.port));
+	}
+	// Members joined at about the same time, so neighbouring heartbeats are close
+	putVarint(out, zigzag(entry.heartbeat - prev.heartbeat));
+	putVarint(out, ((unsigned long)entry.incarnation << 1) | (entry.state == MEMBER_SUSPECT ? 1 : 0));
+}
+
+/**
+ * FUNCTION NAME: encode
+ *
+ * DESCRIPTION: Serialize the message in the compact wire format
+ */
+string MP1Message::encode() {
+	vector<string> out = encodeChunks(0);
+	return out.front();
+}
+
+/**
+ * FUNCTION NAME: encodeChunks
+ *
+ * DESCRIPTION: Serialize the message, splitting the membership list over as many
+ * 				messages as needed to keep each one within maxSize bytes.
+ * 				A maxSize of 0 puts the whole list in a single message.
+ */
+vector<string> MP1Message::encodeChunks(int maxSize) {
+	vector<string> out;
+	string header;
+	header.push_back((char)((MP1_WIRE_VERSION << 4) | msgType));
+	putVarint(header, (unsigned int)id);
+	putVarint(header, zigzag(port));
+	putVarint(header, zigzag(heartbeat));
+
+	if ( msgType == DIGEST ) {
+		header.push_back((char)stage);
+		putFixed64(header, digest);
+		if ( stage != DIGEST_ROOT ) {
+			putVarint(header, bucketDigests.size());
+			for ( unsigned int i = 0; i < bucketDigests.size(); i++ ) {
+				putFixed64(header, bucketDigests[i]);
+			}
+		}
+	}
+
+	if ( !hasEntries() ) {
+		out.push_back(header);
+		return out;
+	}
+
+	// Ids are delta-encoded, so the list goes out sorted
+	vector<MemberListEntry> sorted(entries);
+	sort(sorted.begin(), sorted.end(), compareById);
+
+	unsigned char flags = MP1_FLAG_NOPORTS;
+	for ( unsigned int i = 0; i < sorted.size(); i++ ) {
+		if ( sorted[i].port != 0 ) {
+			flags &= ~MP1_FLAG_NOPORTS;
+			break;
+		}
+	}
+
+	// Split the list first: chunk numbers, flags and the entry count take at most 11 bytes
+	vector<unsigned int> starts(1, 0);
+	int budget = maxSize - (int)header.size() - 11;
+	int used = 0;
+	MemberListEntry first;
+	for ( unsigned int i = 0; maxSize > 0 && i < sorted.size(); i++ ) {
+		string entry;
+		encodeEntry(entry, sorted[i], i == starts.back() ? first : sorted[i-1], flags);
+		if ( used > 0 && used + (int)entry.size() > budget ) {
+			// Restart the deltas in a new chunk
+			starts.push_back(i);
+			entry.clear();
+			encodeEntry(entry, sorted[i], first, flags);
+			used = 0;
+		}
+		used += entry.size();
+	}
+	starts.push_back(sorted.size());
+
+	int chunks = starts.size() - 1;
+	for ( int c = 0; c < chunks; c++ ) {
+		string msg(header);
+		putVarint(msg, c);
+		putVarint(msg, chunks);
+		msg.push_back((char)flags);
+		putVarint(msg, starts[c+1] - starts[c]);
+		for ( unsigned int i = starts[c]; i < starts[c+1]; i++ ) {
+			encodeEntry(msg, sorted[i], i == starts[c] ? first : sorted[i-1], flags);
+		}
+		out.push_back(msg);
+	}
+	return out;
+}
+
+/**
+ * FUNCTION NAME: decode
+ *
+ * DESCRIPTION: Parse a message in the compact wire format
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if the buffer is truncated or was written by another wire version
+ */
+bool MP1Message::decode(char *data, int size) {
+	const unsigned char *ptr = (const unsigned char *)data;
+	const unsigned char *end = ptr + size;
+	unsigned long value;
+
+	entries.clear();
+	bucketDigests.clear();
+	if ( size < 1 || (*ptr >> 4) != MP1_WIRE_VERSION || (*ptr & 0x0f) >= DUMMYLASTMSGTYPE ) {
+		return false;
+	}
+	msgType = static_cast<MsgTypes>(*ptr++ & 0x0f);
+
+	if ( !getVarint(ptr, end, value) ) return false;
+	id = (int)value;
+	if ( !getVarint(ptr, end, value) ) return false;
+	port = (short)unzigzag(value);
+	if ( !getVarint(ptr, end, value) ) return false;
+	heartbeat = unzigzag(value);
+
+	if ( msgType == DIGEST ) {
+		if ( ptr >= end || *ptr > DIGEST_PULL ) return false;
+		stage = static_cast<DigestStage>(*ptr++);
+		if ( !getFixed64(ptr, end, digest) ) return false;
+		if ( stage != DIGEST_ROOT ) {
+			unsigned long count;
+			if ( !getVarint(ptr, end, count) ) return false;
+			if ( count > (unsigned long)(end - ptr) / 8 ) return false;
+			bucketDigests.resize(count);
+			for ( unsigned long i = 0; i < count; i++ ) {
+				getFixed64(ptr, end, bucketDigests[i]);
+			}
+		}
+	}
+
+	if ( !hasEntries() ) {
+		return true;
+	}
+
+	if ( !getVarint(ptr, end, value) ) return false;
+	chunk = (int)value;
+	if ( !getVarint(ptr, end, value) ) return false;
+	chunks = (int)value;
+	if ( ptr >= end ) return false;
+	unsigned char flags = *ptr++;
+	unsigned long count;
+	if ( !getVarint(ptr, end, count) ) return false;
+	// Every entry takes at least three bytes, reject counts the buffer can't hold
+	if ( count > (unsigned long)(end - ptr) ) return false;
+	entries.reserve(count);
+
+	int prevId = 0;
+	long prevHeartbeat = 0;
+	for ( unsigned long i = 0; i < count; i++ ) {
+		MemberListEntry entry;
+		if ( !getVarint(ptr, end, value) ) return false;
+		entry.id = prevId + (int)value;
+		if ( !(flags & MP1_FLAG_NOPORTS) ) {
+			if ( !getVarint(ptr, end, value) ) return false;
+			entry.port = (short)unzigzag(value);
+		}
+		if ( !getVarint(ptr, end, value) ) return false;
+		entry.heartbeat = prevHeartbeat + unzigzag(value);
+		if ( !getVarint(ptr, end, value) ) return false;
+		entry.incarnation = (long)(value >> 1);
+		entry.state = (value & 1) ? MEMBER_SUSPECT : MEMBER_ALIVE;
+		prevId = entry.id;
+		prevHeartbeat = entry.heartbeat;
+		entries.push_back(entry);
+	}
+	return true;
+}
@@ -0,0 +1,101 @@
+/**********************************
+ * FILE NAME: MP1Message.h
+ *
+ * DESCRIPTION: Wire format of the membership protocol messages
+ **********************************/
+
+#ifndef MP1MESSAGE_H_
+#define MP1MESSAGE_H_
+
+#include "stdincludes.h"
+#include "Member.h"
+
+/*
+ * Macros
+ */
+// Bump whenever the layout below changes; receivers drop other versions
+#define MP1_WIRE_VERSION 3
+// Flag set when every entry has port 0 and the port column is omitted
+#define MP1_FLAG_NOPORTS 0x01
+// Id buckets the membership digest is split into
+#define MP1_DIGEST_BUCKETS 16
+
+/**
+ * Message Types
+ */
+enum MsgTypes{
+    JOINREQ,
+    JOINREP,
+    GOSSIP,
+    LEAVE,
+    DIGEST,
+    DUMMYLASTMSGTYPE
+};
+
+/**
+ * Steps of a digest exchange
+ */
+enum DigestStage {
+    // digest of the whole table, the peer answers only if its own differs
+    DIGEST_ROOT,
+    // per bucket digests, the peer sends its entries of the differing buckets
+    DIGEST_BUCKETS,
+    // same, the peer has pushed its entries already and asks for mine
+    DIGEST_PULL
+};
+
+/**
+ * CLASS NAME: MP1Message
+ *
+ * DESCRIPTION: Compact binary encoding of the membership protocol messages.
+ * 				Layout (all integers are LEB128 varints):
+ * 				  byte     version << 4 | msgType
+ * 				  varint   sender id
+ * 				  varint   sender port (zigzag)
+ * 				  varint   sender heartbeat (zigzag)
+ * 				JOINREQ and LEAVE are the header alone.
+ * 				DIGEST carries, after the header:
+ * 				  byte     stage
+ * 				  8 bytes  digest of the whole table
+ * 				  varint   number of buckets, then 8 bytes per bucket (all but DIGEST_ROOT)
+ * 				JOINREP and GOSSIP carry a membership list after the header,
+ * 				possibly split over several messages:
+ * 				  varint   chunk number
+ * 				  varint   number of chunks
+ * 				  byte     flags
+ * 				  varint   number of entries
+ * 				  per entry, sorted by id:
+ * 				    varint id delta from the previous entry of the chunk
+ * 				    varint port (zigzag), absent if MP1_FLAG_NOPORTS
+ * 				    varint heartbeat delta from the previous entry (zigzag)
+ * 				    varint incarnation << 1 | suspect
+ * 				Timestamps are local to each node and are never sent.
+ */
+class MP1Message {
+public:
+	MsgTypes msgType;
+	int id;
+	short port;
+	long heartbeat;
+	// Membership list carried by JOINREP and GOSSIP, timestamps unused
+	vector<MemberListEntry> entries;
+	// Position of this message when the list was split over several messages
+	int chunk;
+	int chunks;
+	// Digest exchange carried by DIGEST
+	DigestStage stage;
+	unsigned long digest;
+	vector<unsigned long> bucketDigests;
+
+	MP1Message();
+	MP1Message(MsgTypes msgType, int id, short port, long heartbeat);
+	// serialize to a byte string ready for ENsend
+	string encode();
+	// serialize into as many messages of at most maxSize bytes as the list needs
+	vector<string> encodeChunks(int maxSize);
+	// parse a received buffer, returns false on a malformed or foreign message
+	bool decode(char *data, int size);
+	bool hasEntries();
+};
+
+#endif /* MP1MESSAGE_H_ */
@@ -25,6 +25,17 @@ MP1Node::MP1Node(Member *member, Params *params, EmulNet *emul, Log *log, Addres
 	this->log = log;
 	this->par = params;
 	this->memberNode->addr = *address;
+	this->fdStats.suspicions = 0;
+	this->fdStats.refutations = 0;
+	this->joinAttempts = 0;
+	this->publishedVersion = 0;
+	this->eventsDropped = false;
+	this->joinRequestsServed = 0;
+	this->leavesSeen = 0;
+	this->aeStats.exchanges = 0;
+	this->aeStats.divergent = 0;
+	this->aeStats.entriesSent = 0;
+	this->aeStats.digestBytes = 0;
 }
 
 /**
@@ -105,6 +116,7 @@ int MP1Node::initThisNode(Address *joinaddr) {
     // node is up!
 	memberNode->nnb = 0;
 	memberNode->heartbeat = 0;
+	memberNode->incarnation = 0;
 	memberNode->pingCounter = TFAIL;
 	memberNode->timeOutCounter = -1;
     initMemberListTable(memberNode);
@@ -118,7 +130,6 @@ int MP1Node::initThisNode(Address *joinaddr) {
  * DESCRIPTION: Join the distributed system
  */
 int MP1Node::introduceSelfToGroup(Address *joinaddr) {
-	MessageHdr *msg;
 #ifdef DEBUGLOG
     static char s[1024];
 #endif
@@ -131,38 +142,57 @@ int MP1Node::introduceSelfToGroup(Address *joinaddr) {
         memberNode->inGroup = true;
     }
     else {
-        size_t msgsize = sizeof(MessageHdr) + sizeof(joinaddr->addr) + sizeof(long) + 1;
-        msg = (MessageHdr *) malloc(msgsize * sizeof(char));
-
-        // create JOINREQ message: format of data is {struct Address myaddr}
-        msg->msgType = JOINREQ;
-        memcpy((char *)(msg+1), &memberNode->addr.addr, sizeof(memberNode->addr.addr));
-        memcpy((char *)(msg+1) + 1 + sizeof(memberNode->addr.addr), &memberNode->heartbeat, sizeof(long));
+        // create JOINREQ message: the header alone carries my address and heartbeat
+        MP1Message msg(JOINREQ, *(int *)(&memberNode->addr.addr), *(short *)(&memberNode->addr.addr[4]), memberNode->heartbeat);
 
 #ifdef DEBUGLOG
         sprintf(s, "Trying to join...");
         log->LOG(&memberNode->addr, s);
 #endif
 
-        // send JOINREQ message to introducer member
-        emulNet->ENsend(&memberNode->addr, joinaddr, (char *)msg, msgsize);
-
-        free(msg);
+        // send JOINREQ message to introducer member, and try another one if it doesn't answer in time
+        sendMessage(joinaddr, msg);
+        memberNode->timeOutCounter = TJOIN;
     }
 
     return 1;
 
 }
 
+/**
+ * FUNCTION NAME: leaveGroup
+ *
+ * DESCRIPTION: Leave the group on purpose
+ * 				Tell every member I know that I am leaving, so they drop me right away
+ * 				instead of waiting TFAIL + TREMOVE, then wind up this node.
+ * 				A LEAVE that gets lost is covered by the failure detector.
+ */
+void MP1Node::leaveGroup() {
+	if ( memberNode->inited && memberNode->inGroup && !memberNode->bFailed ) {
+		MP1Message msg(LEAVE, *(int *)(&memberNode->addr.addr), *(short *)(&memberNode->addr.addr[4]), memberNode->heartbeat);
+		for ( unsigned int i = 0; i < memberNode->memberList.size(); i++ ) {
+			if ( i == memberNode->myPos ) {
+				continue;
+			}
+			Address peer = toAddress(memberNode->memberList[i].getid(), memberNode->memberList[i].getport());
+			sendMessage(&peer, msg);
+		}
+	}
+	finishUpThisNode();
+}
+
 /**
  * FUNCTION NAME: finishUpThisNode
  *
  * DESCRIPTION: Wind up this node and clean up state
  */
 int MP1Node::finishUpThisNode(){
-   /*
-    * Your code goes here
-    */
+	memberNode->inGroup = false;
+	memberNode->memberList.clear();
+	memberNode->nnb = 0;
+	removedMembers.clear();
+	arrivals.clear();
+	return 0;
 }
 
 /**
@@ -181,11 +211,20 @@ void MP1Node::nodeLoop() {
 
     // Wait until you're in the group...
     if( !memberNode->inGroup ) {
-    	return;
+    	if ( memberNode->timeOutCounter > 0 && --memberNode->timeOutCounter == 0 ) {
+    		joinAttempts++;
+    		Address joinaddr = getJoinAddress();
+    		introduceSelfToGroup(&joinaddr);
+    	}
+    }
+    else {
+    	// ...then jump in and share your responsibilites!
+    	nodeLoopOps();
     }
 
-    // ...then jump in and share your responsibilites!
-    nodeLoopOps();
+    // Share what changed in my table this period with the nodes that have the same rows
+    memberNode->memberList.freeze();
+    publishMembership();
 
     return;
 }
@@ -215,9 +254,78 @@ void MP1Node::checkMessages() {
  * DESCRIPTION: Message handler for different message types
  */
 bool MP1Node::recvCallBack(void *env, char *data, int size ) {
-	/*
-	 * Your code goes here
-	 */
+	MP1Message msg;
+	bool decoded = msg.decode(data, size);
+	free(data);
+
+	if ( !decoded ) {
+#ifdef DEBUGLOG
+		log->LOG(&memberNode->addr, "Dropping malformed membership message of %d bytes", size);
+#endif
+		return false;
+	}
+
+	switch ( msg.msgType ) {
+		case JOINREQ: {
+			// Introducer: add the new node and hand it the current membership list.
+			// An introducer that has not joined yet stays silent and the joiner retries elsewhere
+			if ( !memberNode->inGroup ) {
+				break;
+			}
+			joinRequestsServed++;
+			Address joiner = toAddress(msg.id, msg.port);
+			if ( findMember(msg.id) < 0 ) {
+				addMember(msg.id, msg.port, msg.heartbeat);
+			}
+			sendMemberList(&joiner, JOINREP);
+			break;
+		}
+		case JOINREP:
+			// The snapshot may come in several chunks, any of them is enough to start gossiping
+			memberNode->inGroup = true;
+			mergeMemberList(msg.entries);
+			break;
+		case GOSSIP:
+			mergeMemberList(msg.entries);
+			break;
+		case LEAVE: {
+			// Planned departure, the tombstone keeps stale gossip from bringing it back
+			if ( !memberNode->inGroup ) {
+				break;
+			}
+			int pos = findMember(msg.id);
+			if ( pos >= 0 && pos != (int)memberNode->myPos ) {
+				removeMember(pos);
+				leavesSeen++;
+			}
+			break;
+		}
+		case DIGEST: {
+			if ( !memberNode->inGroup ) {
+				break;
+			}
+			Address peer = toAddress(msg.id, msg.port);
+			vector<unsigned long> buckets;
+			unsigned long digest = computeDigests(buckets);
+			if ( msg.stage == DIGEST_ROOT ) {
+				// Same tables cost the initiator's digest and nothing else
+				if ( digest != msg.digest ) {
+					aeStats.divergent++;
+					sendDigest(&peer, DIGEST_BUCKETS, buckets, digest);
+				}
+			}
+			else {
+				sendDifferingBuckets(&peer, msg.bucketDigests, buckets);
+				if ( msg.stage == DIGEST_BUCKETS ) {
+					sendDigest(&peer, DIGEST_PULL, buckets, digest);
+				}
+			}
+			break;
+		}
+		default:
+			return false;
+	}
+	return true;
 }
 
 /**
@@ -228,14 +336,477 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
  * 				Propagate your membership list
  */
 void MP1Node::nodeLoopOps() {
+	long now = par->getcurrtime();
+
+	// Bump my own heartbeat
+	memberNode->heartbeat++;
+	MemberView me = memberNode->memberList[memberNode->myPos];
+	me.setheartbeat(memberNode->heartbeat);
+	me.settimestamp(now);
+	me.setincarnation(memberNode->incarnation);
+
+	// Suspect silent members, remove suspects still silent TREMOVE periods later
+	vector<unsigned int> rows;
+	if ( par->FAILURE_DETECTOR == PHI_DETECTOR ) {
+		// phi depends on the history of each member, every row has to be looked at
+		for ( unsigned int i = 0; i < memberNode->memberList.size(); i++ ) {
+			rows.push_back(i);
+		}
+	}
+	else {
+		// Only members quiet for more than TFAIL periods can be suspected or removed
+		memberNode->memberList.updatedBefore(now - TFAIL, rows);
+	}
+	// Backwards, so that removals do not move the rows still to visit
+	for ( int r = (int)rows.size() - 1; r >= 0; r-- ) {
+		if ( rows[r] == memberNode->myPos ) {
+			continue;
+		}
+		MemberView entry = memberNode->memberList[rows[r]];
+		if ( entry.getstate() == MEMBER_ALIVE && isSilent(entry) ) {
+			markSuspect(entry);
+			fdStats.suspicions++;
+		}
+		if ( entry.getstate() == MEMBER_SUSPECT && isRemovable(entry) ) {
+			fdStats.removals.push_back(make_pair(entry.getid(), now));
+			removeMember(rows[r]);
+		}
+	}
+	// Forget removed members once their suspicion has died out everywhere
+	map<int, pair<long, long> >::iterator tomb = removedMembers.begin();
+	while ( tomb != removedMembers.end() ) {
+		if ( now - tomb->second.second > TREMOVE ) {
+			removedMembers.erase(tomb++);
+		}
+		else {
+			++tomb;
+		}
+	}
+	memberNode->nnb = memberNode->memberList.size() - 1;
 
-	/*
-	 * Your code goes here
-	 */
+	// Gossip to random members, suspects included so they get the chance to refute
+	if ( par->GOSSIP_MODE == ZONE_GOSSIP ) {
+		gossipByZone();
+	}
+	else {
+		vector<int> peers;
+		for ( unsigned int i = 0; i < memberNode->memberList.size(); i++ ) {
+			if ( i != memberNode->myPos ) {
+				peers.push_back(i);
+			}
+		}
+		gossipToRandomPeers(peers, GOSSIP_FANOUT);
+	}
+
+	if ( par->ANTI_ENTROPY > 0 && memberNode->heartbeat % par->ANTI_ENTROPY == 0 ) {
+		startAntiEntropy();
+	}
 
     return;
 }
 
+/**
+ * FUNCTION NAME: gossipByZone
+ *
+ * DESCRIPTION: Topology aware gossip. Every member gossips to GOSSIP_FANOUT peers in its
+ * 				own zone. The ZONE_RELAYS lowest ids of each zone that are not suspected
+ * 				also gossip to one member of every other zone.
+ */
+void MP1Node::gossipByZone() {
+	int myId = memberNode->memberList[memberNode->myPos].getid();
+	int myZone = par->getZone(myId);
+	int lowerIds = 0;
+	vector<int> local;
+	vector<vector<int> > remote(par->ZONES);
+
+	for ( unsigned int i = 0; i < memberNode->memberList.size(); i++ ) {
+		if ( i == memberNode->myPos ) {
+			continue;
+		}
+		MemberView entry = memberNode->memberList[i];
+		if ( par->getZone(entry.getid()) == myZone ) {
+			local.push_back(i);
+			if ( entry.getid() < myId && entry.getstate() == MEMBER_ALIVE ) {
+				lowerIds++;
+			}
+		}
+		else {
+			remote[par->getZone(entry.getid())].push_back(i);
+		}
+	}
+
+	gossipToRandomPeers(local, GOSSIP_FANOUT);
+	if ( lowerIds < par->ZONE_RELAYS ) {
+		for ( int zone = 0; zone < par->ZONES; zone++ ) {
+			gossipToRandomPeers(remote[zone], 1);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: gossipToRandomPeers
+ *
+ * DESCRIPTION: Send my membership list to up to fanout members picked at random
+ * 				from the given positions in the membership list
+ */
+void MP1Node::gossipToRandomPeers(vector<int> &peers, int fanout) {
+	for ( int i = 0; i < fanout && i < (int)peers.size(); i++ ) {
+		int j = i + rand() % (peers.size() - i);
+		swap(peers[i], peers[j]);
+		MemberView peer = memberNode->memberList[peers[i]];
+		Address peerAddr = toAddress(peer.getid(), peer.getport());
+		sendMemberList(&peerAddr, GOSSIP);
+	}
+}
+
+/**
+ * FUNCTION NAME: sendMessage
+ *
+ * DESCRIPTION: Encode a membership message and hand it to the emulated network
+ */
+int MP1Node::sendMessage(Address *toaddr, MP1Message &msg) {
+	string data = msg.encode();
+	return emulNet->ENsend(&memberNode->addr, toaddr, (char *)data.data(), data.size());
+}
+
+/**
+ * FUNCTION NAME: sendMemberList
+ *
+ * DESCRIPTION: Send my membership list, suspicions included so that they spread.
+ * 				The list is split into chunks that each fit in MAX_MSG_SIZE.
+ */
+void MP1Node::sendMemberList(Address *toaddr, MsgTypes msgType) {
+	vector<MemberListEntry> entries = memberNode->memberList.entries();
+	sendEntries(toaddr, msgType, entries);
+}
+
+/**
+ * FUNCTION NAME: sendEntries
+ *
+ * DESCRIPTION: Send some entries of my membership list in as many chunks as they need
+ */
+void MP1Node::sendEntries(Address *toaddr, MsgTypes msgType, vector<MemberListEntry> &entries) {
+	MP1Message msg(msgType, *(int *)(&memberNode->addr.addr), *(short *)(&memberNode->addr.addr[4]), memberNode->heartbeat);
+
+	msg.entries = entries;
+	// ENsend drops anything that does not leave room for its en_msg header
+	vector<string> chunks = msg.encodeChunks(par->MAX_MSG_SIZE - sizeof(en_msg) - 1);
+	for ( unsigned int i = 0; i < chunks.size(); i++ ) {
+		emulNet->ENsend(&memberNode->addr, toaddr, (char *)chunks[i].data(), chunks[i].size());
+	}
+}
+
+/**
+ * FUNCTION NAME: entryDigest
+ *
+ * DESCRIPTION: Hash of the parts of an entry that only change on membership events.
+ * 				Heartbeats are left out, they differ between any two tables at any time.
+ */
+static unsigned long entryDigest(MemberView entry) {
+	// splitmix64 finalizer
+	unsigned long x = ((unsigned long)(unsigned int)entry.getid() << 32) ^ ((unsigned long)entry.getincarnation() << 1) ^ entry.getstate();
+	x += 0x9e3779b97f4a7c15UL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9UL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebUL;
+	return x ^ (x >> 31);
+}
+
+/**
+ * FUNCTION NAME: computeDigests
+ *
+ * DESCRIPTION: XOR the entry hashes of my table into MP1_DIGEST_BUCKETS buckets by id.
+ * 				Returns the XOR of all of them, the digest of the whole table.
+ */
+unsigned long MP1Node::computeDigests(vector<unsigned long> &buckets) {
+	unsigned long digest = 0;
+	buckets.assign(MP1_DIGEST_BUCKETS, 0);
+	for ( unsigned int i = 0; i < memberNode->memberList.size(); i++ ) {
+		MemberView entry = memberNode->memberList[i];
+		unsigned long hash = entryDigest(entry);
+		buckets[(unsigned int)entry.getid() % MP1_DIGEST_BUCKETS] ^= hash;
+		digest ^= hash;
+	}
+	return digest;
+}
+
+/**
+ * FUNCTION NAME: startAntiEntropy
+ *
+ * DESCRIPTION: Send the digest of my table to a random member. Entries only move
+ * 				if the digests differ, see recvCallBack.
+ */
+void MP1Node::startAntiEntropy() {
+	if ( memberNode->memberList.size() < 2 ) {
+		return;
+	}
+	// Any row but mine
+	unsigned int row = rand() % (memberNode->memberList.size() - 1);
+	if ( row >= memberNode->myPos ) {
+		row++;
+	}
+	MemberView peer = memberNode->memberList[row];
+	Address peerAddr = toAddress(peer.getid(), peer.getport());
+	vector<unsigned long> buckets;
+	unsigned long digest = computeDigests(buckets);
+	sendDigest(&peerAddr, DIGEST_ROOT, buckets, digest);
+	aeStats.exchanges++;
+}
+
+/**
+ * FUNCTION NAME: sendDigest
+ *
+ * DESCRIPTION: Send one step of a digest exchange, the buckets are left out of DIGEST_ROOT
+ */
+void MP1Node::sendDigest(Address *toaddr, DigestStage stage, vector<unsigned long> &buckets, unsigned long digest) {
+	MP1Message msg(DIGEST, *(int *)(&memberNode->addr.addr), *(short *)(&memberNode->addr.addr[4]), memberNode->heartbeat);
+	msg.stage = stage;
+	msg.digest = digest;
+	if ( stage != DIGEST_ROOT ) {
+		msg.bucketDigests = buckets;
+	}
+	aeStats.digestBytes += sendMessage(toaddr, msg);
+}
+
+/**
+ * FUNCTION NAME: sendDifferingBuckets
+ *
+ * DESCRIPTION: Gossip my entries of the buckets whose digests differ from the peer's
+ */
+void MP1Node::sendDifferingBuckets(Address *toaddr, vector<unsigned long> &theirs, vector<unsigned long> &mine) {
+	vector<MemberListEntry> entries;
+	for ( unsigned int i = 0; i < memberNode->memberList.size(); i++ ) {
+		MemberView entry = memberNode->memberList[i];
+		unsigned int bucket = (unsigned int)entry.getid() % MP1_DIGEST_BUCKETS;
+		// A peer bucketing differently gets everything
+		if ( theirs.size() != mine.size() || theirs[bucket] != mine[bucket] ) {
+			entries.push_back(entry.entry());
+		}
+	}
+	if ( !entries.empty() ) {
+		sendEntries(toaddr, GOSSIP, entries);
+		aeStats.entriesSent += entries.size();
+	}
+}
+
+/**
+ * FUNCTION NAME: mergeMemberList
+ *
+ * DESCRIPTION: Merge a received membership list into mine
+ * 				A higher incarnation always wins and counts as fresh evidence of life.
+ * 				At equal incarnations newer heartbeats refresh the local timestamp and
+ * 				a suspicion overrides alive. Only the member itself can clear a suspicion,
+ * 				by bumping its incarnation.
+ */
+void MP1Node::mergeMemberList(vector<MemberListEntry> &entries) {
+	int myId = memberNode->memberList[memberNode->myPos].getid();
+
+	for ( unsigned int i = 0; i < entries.size(); i++ ) {
+		MemberListEntry &remote = entries[i];
+		if ( remote.id == myId ) {
+			// Someone suspects me, refute with a newer incarnation
+			if ( remote.state == MEMBER_SUSPECT && remote.incarnation >= memberNode->incarnation ) {
+				memberNode->incarnation = remote.incarnation + 1;
+				memberNode->memberList[memberNode->myPos].setincarnation(memberNode->incarnation);
+				fdStats.refutations++;
+			}
+			continue;
+		}
+
+		map<int, pair<long, long> >::iterator tomb = removedMembers.find(remote.id);
+		if ( tomb != removedMembers.end() ) {
+			if ( remote.incarnation <= tomb->second.first ) {
+				// Stale gossip about a member I already removed
+				continue;
+			}
+			removedMembers.erase(tomb);
+		}
+
+		int pos = findMember(remote.id);
+		if ( pos < 0 ) {
+			MemberView entry = memberNode->memberList[addMember(remote.id, remote.port, remote.heartbeat)];
+			entry.setincarnation(remote.incarnation);
+			entry.setstate(remote.state);
+			continue;
+		}
+
+		MemberView entry = memberNode->memberList[pos];
+		if ( remote.incarnation > entry.getincarnation() ) {
+			entry.setincarnation(remote.incarnation);
+			entry.setstate(MEMBER_ALIVE);
+			if ( remote.state == MEMBER_SUSPECT ) {
+				markSuspect(entry);
+			}
+			entry.setheartbeat(max(entry.getheartbeat(), remote.heartbeat));
+			heardFrom(entry);
+		}
+		else if ( remote.incarnation == entry.getincarnation() ) {
+			if ( remote.heartbeat > entry.getheartbeat() ) {
+				entry.setheartbeat(remote.heartbeat);
+				heardFrom(entry);
+			}
+			if ( remote.state == MEMBER_SUSPECT && entry.getstate() == MEMBER_ALIVE ) {
+				markSuspect(entry);
+			}
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: heardFrom
+ *
+ * DESCRIPTION: Record fresh evidence that a member is alive
+ */
+void MP1Node::heardFrom(MemberView entry) {
+	long now = par->getcurrtime();
+	if ( par->FAILURE_DETECTOR == PHI_DETECTOR ) {
+		arrivals[entry.getid()].record(now);
+	}
+	entry.settimestamp(now);
+}
+
+/**
+ * FUNCTION NAME: markSuspect
+ *
+ * DESCRIPTION: Move a member to the suspect state, locally detected or learnt by gossip
+ */
+void MP1Node::markSuspect(MemberView entry) {
+	entry.setstate(MEMBER_SUSPECT);
+	if ( par->FAILURE_DETECTOR == PHI_DETECTOR ) {
+		arrivals[entry.getid()].suspectedAt = par->getcurrtime();
+	}
+}
+
+/**
+ * FUNCTION NAME: isSilent
+ *
+ * DESCRIPTION: Returns true if the member has been quiet for long enough to suspect it.
+ * 				The timeout detector waits TFAIL periods. The phi accrual detector waits until
+ * 				phi crosses PHI_THRESHOLD, and falls back to TFAIL until it has seen two intervals.
+ */
+bool MP1Node::isSilent(MemberView entry) {
+	long now = par->getcurrtime();
+	if ( par->FAILURE_DETECTOR == PHI_DETECTOR ) {
+		ArrivalWindow &window = arrivals[entry.getid()];
+		if ( window.hasHistory() ) {
+			return window.phi(now) > par->PHI_THRESHOLD;
+		}
+	}
+	return now - entry.gettimestamp() > TFAIL;
+}
+
+/**
+ * FUNCTION NAME: isRemovable
+ *
+ * DESCRIPTION: Returns true if a suspect has to be removed. The timeout detector removes
+ * 				TFAIL + TREMOVE periods after the last heartbeat. The phi accrual detector
+ * 				removes suspects that are still silent TREMOVE periods after the suspicion.
+ */
+bool MP1Node::isRemovable(MemberView entry) {
+	long now = par->getcurrtime();
+	if ( par->FAILURE_DETECTOR == PHI_DETECTOR ) {
+		return isSilent(entry) && now - arrivals[entry.getid()].suspectedAt > TREMOVE;
+	}
+	return now - entry.gettimestamp() > TFAIL + TREMOVE;
+}
+
+/**
+ * FUNCTION NAME: findMember
+ *
+ * DESCRIPTION: Returns the position of the member with the given id in memberList, -1 if unknown
+ */
+int MP1Node::findMember(int id) {
+	return memberNode->memberList.find(id);
+}
+
+/**
+ * FUNCTION NAME: addMember
+ *
+ * DESCRIPTION: Add a new member to the membership list, log the join and return its row
+ */
+unsigned int MP1Node::addMember(int id, short port, long heartbeat) {
+	Address added = toAddress(id, port);
+	unsigned int row = memberNode->memberList.insert(MemberListEntry(id, port, heartbeat, par->getcurrtime()));
+	if ( par->FAILURE_DETECTOR == PHI_DETECTOR ) {
+		arrivals[id] = ArrivalWindow(par->getcurrtime());
+	}
+	if ( row <= memberNode->myPos ) {
+		memberNode->myPos++;
+	}
+	memberNode->nnb = memberNode->memberList.size() - 1;
+	notifyMembershipChange(MEMBER_JOINED, id, port);
+	log->logNodeAdd(&memberNode->addr, &added);
+	return row;
+}
+
+/**
+ * FUNCTION NAME: removeMember
+ *
+ * DESCRIPTION: Drop a member from the membership list, log the removal and leave a
+ * 				tombstone at its current incarnation. Later rows move up by one.
+ */
+void MP1Node::removeMember(unsigned int pos) {
+	MemberView entry = memberNode->memberList[pos];
+	Address removed = toAddress(entry.getid(), entry.getport());
+	log->logNodeRemove(&memberNode->addr, &removed);
+	removedMembers[entry.getid()] = make_pair(entry.getincarnation(), (long)par->getcurrtime());
+	notifyMembershipChange(MEMBER_LEFT, entry.getid(), entry.getport());
+	arrivals.erase(entry.getid());
+	memberNode->memberList.erase(pos);
+	if ( pos < memberNode->myPos ) {
+		memberNode->myPos--;
+	}
+	memberNode->nnb = memberNode->memberList.size() - 1;
+}
+
+/**
+ * FUNCTION NAME: notifyMembershipChange
+ *
+ * DESCRIPTION: Bump the membership version and record the change for the KV store
+ */
+void MP1Node::notifyMembershipChange(MembershipEventType type, int id, short port) {
+	memberNode->membershipVersion++;
+	if ( unpublishedEvents.size() >= MAX_MEMBERSHIP_EVENTS ) {
+		unpublishedEvents.clear();
+		eventsDropped = true;
+	}
+	if ( !eventsDropped ) {
+		unpublishedEvents.push_back(MembershipEvent(type, id, port, memberNode->membershipVersion));
+	}
+}
+
+/**
+ * FUNCTION NAME: publishMembership
+ *
+ * DESCRIPTION: Publish a snapshot of my membership for the KV store if it changed since
+ * 				the last one. Called once a period, after the table has been frozen.
+ */
+void MP1Node::publishMembership() {
+	if ( publishedVersion == memberNode->membershipVersion ) {
+		return;
+	}
+	MembershipSnapshot *snapshot = new MembershipSnapshot();
+	snapshot->version = memberNode->membershipVersion;
+	snapshot->previousVersion = eventsDropped ? -1 : publishedVersion;
+	snapshot->events.swap(unpublishedEvents);
+	snapshot->ids = memberNode->memberList.ids;
+	snapshot->ports = memberNode->memberList.ports;
+	memberNode->membership.publish(snapshot);
+	publishedVersion = snapshot->version;
+	eventsDropped = false;
+}
+
+/**
+ * FUNCTION NAME: toAddress
+ *
+ * DESCRIPTION: Build the Address of a member from its id and port
+ */
+Address MP1Node::toAddress(int id, short port) {
+	Address addr;
+	memcpy(&addr.addr[0], &id, sizeof(int));
+	memcpy(&addr.addr[4], &port, sizeof(short));
+	return addr;
+}
+
 /**
  * FUNCTION NAME: isNullAddress
  *
@@ -248,16 +819,25 @@ int MP1Node::isNullAddress(Address *addr) {
 /**
  * FUNCTION NAME: getJoinAddress
  *
- * DESCRIPTION: Returns the Address of the coordinator
+ * DESCRIPTION: Returns the Address of the introducer to send the JOINREQ to.
+ * 				Joiners are spread over the configured introducers by id and move on
+ * 				to the next introducer on every retry. The first introducer boots the group.
  */
 Address MP1Node::getJoinAddress() {
-    Address joinaddr;
-
-    memset(&joinaddr, 0, sizeof(Address));
-    *(int *)(&joinaddr.addr) = 1;
-    *(short *)(&joinaddr.addr[4]) = 0;
+    vector<int> &introducers = par->INTRODUCERS;
+    int myId = *(int *)(&memberNode->addr.addr);
+    int id = introducers[0];
+
+    if ( myId != introducers[0] ) {
+        for ( unsigned int i = 0; i < introducers.size(); i++ ) {
+            id = introducers[(myId + joinAttempts + i) % introducers.size()];
+            if ( id != myId ) {
+                break;
+            }
+        }
+    }
 
-    return joinaddr;
+    return toAddress(id, 0);
 }
 
 /**
@@ -266,7 +846,13 @@ Address MP1Node::getJoinAddress() {
  * DESCRIPTION: Initialize the membership list
  */
 void MP1Node::initMemberListTable(Member *memberNode) {
+	int id = *(int *)(&memberNode->addr.addr);
+	short port = *(short *)(&memberNode->addr.addr[4]);
+
 	memberNode->memberList.clear();
+	// Rows are kept in id order so that tables with the same members share their columns
+	memberNode->myPos = memberNode->memberList.insert(MemberListEntry(id, port, memberNode->heartbeat, par->getcurrtime()));
+	notifyMembershipChange(MEMBER_JOINED, id, port);
 }
 
 /**
@@ -14,34 +14,52 @@
 #include "Member.h"
 #include "EmulNet.h"
 #include "Queue.h"
+#include "MP1Message.h"
+#include "ArrivalWindow.h"
 
 /**
  * Macros
  */
 #define TREMOVE 20
 #define TFAIL 5
+// number of random peers the membership list is gossiped to every period
+#define GOSSIP_FANOUT 3
+// periods a joiner waits for a JOINREP before asking the next introducer
+#define TJOIN 5
 
 /*
  * Note: You can change/add any functions in MP1Node.{h,cpp}
  */
 
 /**
- * Message Types
+ * STRUCT NAME: FailureDetectorStats
+ *
+ * DESCRIPTION: Counters kept by the failure detector of a node
  */
-enum MsgTypes{
-    JOINREQ,
-    JOINREP,
-    DUMMYLASTMSGTYPE
-};
+typedef struct FailureDetectorStats {
+	// members this node started suspecting
+	long suspicions;
+	// suspicions of this node it refuted by bumping its incarnation
+	long refutations;
+	// (id of the removed member, time of removal)
+	vector<pair<int, long> > removals;
+} FailureDetectorStats;
 
 /**
- * STRUCT NAME: MessageHdr
+ * STRUCT NAME: AntiEntropyStats
  *
- * DESCRIPTION: Header and content of a message
+ * DESCRIPTION: Counters kept by the membership anti-entropy of a node
  */
-typedef struct MessageHdr {
-	enum MsgTypes msgType;
-}MessageHdr;
+typedef struct AntiEntropyStats {
+	// digest exchanges this node started
+	long exchanges;
+	// exchanges it answered because the digests differed
+	long divergent;
+	// entries sent to repair differing buckets
+	long entriesSent;
+	// bytes of DIGEST messages sent
+	long digestBytes;
+} AntiEntropyStats;
 
 /**
  * CLASS NAME: MP1Node
@@ -55,8 +73,27 @@ private:
 	Params *par;
 	Member *memberNode;
 	char NULLADDR[6];
+	// Removed members: id -> (incarnation at removal, time of removal)
+	map<int, pair<long, long> > removedMembers;
+	// Heartbeat arrival history of each member id, phi accrual detector only
+	map<int, ArrivalWindow> arrivals;
+	// JOINREQs sent without an answer so far
+	int joinAttempts;
+	// Joins and leaves since the last published snapshot
+	vector<MembershipEvent> unpublishedEvents;
+	// more than MAX_MEMBERSHIP_EVENTS of them happened, the next snapshot carries none
+	bool eventsDropped;
+	// Membership version of the last published snapshot
+	long publishedVersion;
 
 public:
+	FailureDetectorStats fdStats;
+	AntiEntropyStats aeStats;
+	// JOINREQs this node answered as an introducer
+	long joinRequestsServed;
+	// members this node removed on their LEAVE instead of timing them out
+	long leavesSeen;
+
 	MP1Node(Member *, Params *, EmulNet *, Log *, Address *);
 	Member * getMemberNode() {
 		return memberNode;
@@ -66,6 +103,7 @@ public:
 	void nodeStart(char *servaddrstr, short serverport);
 	int initThisNode(Address *joinaddr);
 	int introduceSelfToGroup(Address *joinAddress);
+	void leaveGroup();
 	int finishUpThisNode();
 	void nodeLoop();
 	void checkMessages();
@@ -74,6 +112,26 @@ public:
 	int isNullAddress(Address *addr);
 	Address getJoinAddress();
 	void initMemberListTable(Member *memberNode);
+	int sendMessage(Address *toaddr, MP1Message &msg);
+	void sendMemberList(Address *toaddr, MsgTypes msgType);
+	void sendEntries(Address *toaddr, MsgTypes msgType, vector<MemberListEntry> &entries);
+	unsigned long computeDigests(vector<unsigned long> &buckets);
+	void sendDigest(Address *toaddr, DigestStage stage, vector<unsigned long> &buckets, unsigned long digest);
+	void sendDifferingBuckets(Address *toaddr, vector<unsigned long> &theirs, vector<unsigned long> &mine);
+	void startAntiEntropy();
+	void gossipByZone();
+	void gossipToRandomPeers(vector<int> &peers, int fanout);
+	void mergeMemberList(vector<MemberListEntry> &entries);
+	int findMember(int id);
+	void heardFrom(MemberView entry);
+	void markSuspect(MemberView entry);
+	bool isSilent(MemberView entry);
+	bool isRemovable(MemberView entry);
+	unsigned int addMember(int id, short port, long heartbeat);
+	void removeMember(unsigned int pos);
+	Address toAddress(int id, short port);
+	void notifyMembershipChange(MembershipEventType type, int id, short port);
+	void publishMembership();
 	void printAddress(Address *addr);
 	virtual ~MP1Node();
 };
@@ -13,14 +13,51 @@ MP2Node::MP2Node(Member *memberNode, Params *par, EmulNet * emulNet, Log * log,
 	this->par = par;
 	this->emulNet = emulNet;
 	this->log = log;
+	this->ringVersion = 0;
+	this->ringEpoch = 0;
+	this->nextCopyID = STABILIZATION_TRANSID;
+	this->wholeRingChanged = false;
+	this->neighborsTouched = false;
+	this->replicaOfAll = false;
+	this->neighborsKnown = false;
+	memset(&stabStats, 0, sizeof(stabStats));
+	memset(&loadStats, 0, sizeof(loadStats));
 	ht = new HashTable();
 	this->memberNode->addr = *address;
+	this->snapshotReader = memberNode->membership.registerReader();
+	if ( snapshotReader < 0 ) {
+		// Without a slot the ring would never follow the membership
+		cout<<endl<<"More than MAX_SNAPSHOT_READERS KV store nodes read the membership of one member. Exiting!!!"<<endl;
+		log->LOG(address, "No free membership reader slot out of %d", MAX_SNAPSHOT_READERS);
+		exit(1);
+	}
+	Ring *empty = new Ring();
+	empty->setPlacement(par->PLACEMENT);
+	empty->setZones(&par->nodeZone, par->ZONES);
+	ring = Ring::intern(RingView(), empty);
+	for ( int v = 0; v < par->getVnodes(*(int *)(&address->addr)); v++ ) {
+		myPositions.push_back(Node(*address, v).getHashCode());
+	}
+}
+
+/**
+ * FUNCTION NAME: inRange
+ *
+ * DESCRIPTION: Whether a position is in the range (start, end], which wraps past the top
+ * 				of the ring if start >= end
+ */
+static bool inRange(const pair<size_t, size_t> &range, size_t pos) {
+	if ( range.first < range.second ) {
+		return range.first < pos && pos <= range.second;
+	}
+	return range.first < pos || pos <= range.second;
 }
 
 /**
  * Destructor
  */
 MP2Node::~MP2Node() {
+	memberNode->membership.unregisterReader(snapshotReader);
 	delete ht;
 	delete memberNode;
 }
@@ -29,56 +66,271 @@ MP2Node::~MP2Node() {
  * FUNCTION NAME: updateRing
  *
  * DESCRIPTION: This function does the following:
- * 				1) Gets the current membership list from the Membership Protocol (MP1Node)
- * 				   The membership list is returned as a vector of Nodes. See Node class in Node.h
- * 				2) Constructs the ring based on the membership list
- * 				3) Calls the Stabilization Protocol
+ * 				1) Checks whether the Membership Protocol (MP1Node) published a snapshot
+ * 				   with joins or leaves since the ring was last built, and returns right
+ * 				   away if not
+ * 				2) Patches the ring with the events of the snapshot, noting the key
+ * 				   ranges whose replicas changed, or rebuilds it from the full membership
+ * 				   list of the snapshot if it does not follow on from the ring. Either
+ * 				   way, the ring another node built from the same membership is taken
+ * 				   instead if there is one
+ * 				3) Updates my replica neighbors if a node joined or left next to me
+ * 				4) Calls the Stabilization Protocol on the changed ranges if my
+ * 				   neighbors changed, since the replicas of the keys I hold did not
+ * 				   change otherwise
+ * 				The snapshot is immutable and read without locks, MP1 may publish the
+ * 				next one meanwhile.
  */
 void MP2Node::updateRing() {
-	/*
-	 * Implement this. Parts of it are already implemented
-	 */
 	vector<Node> curMemList;
-	bool change = false;
+	bool churn = false;
 
 	/*
-	 *  Step 1. Get the current membership list from Membership Protocol / MP1
+	 *  Step 1. Nothing to do unless the membership changed
 	 */
-	curMemList = getMembershipList();
+	const MembershipSnapshot *snapshot = memberNode->membership.acquire(snapshotReader);
+	if ( !snapshot || ringVersion == snapshot->version ) {
+		memberNode->membership.release(snapshotReader);
+		return;
+	}
 
 	/*
 	 * Step 2: Construct the ring
 	 */
-	// Sort the list based on the hashCode
-	sort(curMemList.begin(), curMemList.end());
+	RingView view;
+	if ( !snapshot->ids.shareChunks(view) || !snapshot->ports.shareChunks(view) ) {
+		view.clear();
+	}
+	if ( !patchRing(snapshot, view) ) {
+		shared_ptr<const Ring> next = Ring::findShared(view);
+		if ( !next ) {
+			curMemList = getMembershipList(snapshot);
+			// The ring sorts the list based on the hashCode
+			Ring *built = new Ring();
+			built->setPlacement(par->PLACEMENT);
+			built->setZones(&par->nodeZone, par->ZONES);
+			built->assign(curMemList);
+			next = Ring::intern(view, built);
+		}
+		ring = next;
+		wholeRingChanged = true;
+	}
+	ringVersion = snapshot->version;
+	ringEpoch = ring->membersHash();
+	memberNode->membership.release(snapshotReader);
 
+	/*
+	 * Step 3: Update the neighbors
+	 */
+	if ( wholeRingChanged || neighborsTouched ) {
+		churn = findNeighbors();
+	}
 
 	/*
-	 * Step 3: Run the stabilization protocol IF REQUIRED
+	 * Step 4: Run the stabilization protocol IF REQUIRED
 	 */
-	// Run stabilization protocol if the hash table size is greater than zero and if there has been a changed in the ring
+	// Run stabilization protocol if the hash table size is greater than zero and if the replica sets around me changed
+	if ( churn && !ht->isEmpty() ) {
+		stabilizationProtocol();
+	}
+	changedRanges.clear();
+	wholeRingChanged = false;
+	neighborsTouched = false;
+}
+
+/**
+ * FUNCTION NAME: patchRing
+ *
+ * DESCRIPTION: Apply the membership events of a snapshot to a copy of the ring, or take
+ * 				the shared ring of the same view, and add the key ranges whose replicas
+ * 				went through a joined or left node to changedRanges. Those are taken
+ * 				with the node on the ring: the ring before the events for a leave, the
+ * 				ring after them for a join. The ranges of a leave on the ring before a
+ * 				join of the same snapshot may miss keys the join moved, so a snapshot
+ * 				with both makes stabilization visit every key instead.
+ *
+ * RETURNS:
+ * true if the ring was patched
+ * false if the snapshot does not follow on from ringVersion
+ */
+bool MP2Node::patchRing(const MembershipSnapshot *snapshot, const RingView &view) {
+	if ( snapshot->previousVersion != ringVersion ) {
+		return false;
+	}
+
+	const vector<MembershipEvent> &events = snapshot->events;
+	vector<Address> addresses(events.size());
+	unsigned int joins = 0;
+	for ( unsigned int e = 0; e < events.size(); e++ ) {
+		joins += events[e].type == MEMBER_JOINED;
+	}
+	if ( joins > 0 && joins < events.size() ) {
+		wholeRingChanged = true;
+	}
+
+	shared_ptr<const Ring> next = Ring::findShared(view);
+	Ring *patched = next ? NULL : new Ring(*ring);
+	for ( unsigned int e = 0; e < events.size(); e++ ) {
+		memcpy(&addresses[e].addr[0], &events[e].id, sizeof(int));
+		memcpy(&addresses[e].addr[4], &events[e].port, sizeof(short));
+
+		int vnodes = par->getVnodes(events[e].id);
+		if ( events[e].type == MEMBER_JOINED ) {
+			if ( patched ) {
+				patched->insertMember(addresses[e], vnodes);
+			}
+		}
+		else {
+			if ( !wholeRingChanged ) {
+				noteChangedRanges(*ring, addresses[e], vnodes);
+			}
+			if ( patched ) {
+				patched->eraseMember(addresses[e], vnodes);
+			}
+		}
+	}
+	if ( patched ) {
+		next = Ring::intern(view, patched);
+	}
+
+	for ( unsigned int e = 0; e < events.size() && !wholeRingChanged; e++ ) {
+		if ( events[e].type == MEMBER_JOINED ) {
+			noteChangedRanges(*next, addresses[e], par->getVnodes(events[e].id));
+		}
+	}
+	ring = next;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: noteChangedRanges
+ *
+ * DESCRIPTION: Add the ranges whose replicas go through a node on the given ring to
+ * 				changedRanges, and note whether they are near me. A node that is not
+ * 				on that ring, as one that joined and left within the snapshot, adds none.
+ */
+void MP2Node::noteChangedRanges(const Ring &on, Address &address, int vnodes) {
+	unsigned int firstRange = changedRanges.size();
+	if ( !on.affectedRanges(address, vnodes, par->REPLICATION, changedRanges) ) {
+		wholeRingChanged = true;
+	}
+	else if ( !neighborsTouched ) {
+		neighborsTouched = nearMe(firstRange);
+	}
+}
+
+/**
+ * FUNCTION NAME: nearMe
+ *
+ * DESCRIPTION: Whether the node whose changed ranges start at changedRanges[firstRange]
+ * 				is within REPLICATION - 1 nodes of one of my positions: one of my
+ * 				positions is in its ranges, or one of its positions, which end its
+ * 				ranges, is in mine. My ranges are those before the change, which only
+ * 				grow with a leave and shrink with a join, so the test holds for both.
+ */
+bool MP2Node::nearMe(unsigned int firstRange) {
+	if ( !neighborsKnown || replicaOfAll ) {
+		return true;
+	}
+	for ( unsigned int i = firstRange; i < changedRanges.size(); i++ ) {
+		for ( unsigned int j = 0; j < myPositions.size(); j++ ) {
+			if ( inRange(changedRanges[i], myPositions[j]) ) {
+				return true;
+			}
+		}
+		for ( unsigned int j = 0; j < replicaRanges.size(); j++ ) {
+			if ( inRange(replicaRanges[j], changedRanges[i].second) ) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: findNeighbors
+ *
+ * DESCRIPTION: Recompute hasMyReplicas, haveReplicasOf and the ranges of the keys I hold
+ * 				replicas of from the ring. Called only when a node joined or left next
+ * 				to me.
+ *
+ * RETURNS:
+ * true if the neighbors changed, or the placement has none and anything may have
+ */
+bool MP2Node::findNeighbors() {
+	vector<Node> successors, predecessors;
+	int vnodes = myPositions.size();
+
+	neighborsKnown = ring->neighborsOf(memberNode->addr, vnodes, par->REPLICATION, successors, predecessors);
+	replicaRanges.clear();
+	replicaOfAll = !ring->affectedRanges(memberNode->addr, vnodes, par->REPLICATION, replicaRanges);
+	if ( !neighborsKnown ) {
+		return true;
+	}
+
+	bool changed = successors.size() != hasMyReplicas.size() || predecessors.size() != haveReplicasOf.size();
+	for ( unsigned int i = 0; i < successors.size() && !changed; i++ ) {
+		changed = !(successors[i].nodeAddress == hasMyReplicas[i].nodeAddress);
+	}
+	for ( unsigned int i = 0; i < predecessors.size() && !changed; i++ ) {
+		changed = !(predecessors[i].nodeAddress == haveReplicasOf[i].nodeAddress);
+	}
+	hasMyReplicas = successors;
+	haveReplicasOf = predecessors;
+	return changed;
+}
+
+/**
+ * FUNCTION NAME: isReplicaFor
+ *
+ * DESCRIPTION: Whether I hold a replica of the keys at a ring position. A check of the
+ * 				ranges kept with the neighbors, one per position of mine.
+ */
+bool MP2Node::isReplicaFor(size_t pos) {
+	if ( !neighborsKnown ) {
+		vector<Node> replicas;
+		ring->replicasOf(pos, par->REPLICATION, replicas);
+		for ( unsigned int i = 0; i < replicas.size(); i++ ) {
+			if ( isMe(replicas[i]) ) {
+				return true;
+			}
+		}
+		return false;
+	}
+	if ( replicaOfAll ) {
+		return true;
+	}
+	for ( unsigned int i = 0; i < replicaRanges.size(); i++ ) {
+		if ( inRange(replicaRanges[i], pos) ) {
+			return true;
+		}
+	}
+	return false;
 }
 
 /**
  * FUNCTION NAME: getMemberhipList
  *
- * DESCRIPTION: This function goes through the membership list from the Membership protocol/MP1 and
+ * DESCRIPTION: This function goes through a membership snapshot from the Membership protocol/MP1 and
  * 				i) generates the hash code for each member
  * 				ii) populates the ring member in MP2Node class
- * 				It returns a vector of Nodes. Each element in the vector contain the following fields:
+ * 				It returns a vector of Nodes, par->getVnodes() of them per member. Each element
+ * 				in the vector contain the following fields:
  * 				a) Address of the node
- * 				b) Hash code obtained by consistent hashing of the Address
+ * 				b) Hash code obtained by consistent hashing of the Address and position number
  */
-vector<Node> MP2Node::getMembershipList() {
+vector<Node> MP2Node::getMembershipList(const MembershipSnapshot *snapshot) {
 	unsigned int i;
 	vector<Node> curMemList;
-	for ( i = 0 ; i < this->memberNode->memberList.size(); i++ ) {
+	for ( i = 0 ; i < snapshot->ids.size(); i++ ) {
 		Address addressOfThisMember;
-		int id = this->memberNode->memberList.at(i).getid();
-		short port = this->memberNode->memberList.at(i).getport();
+		int id = snapshot->ids.get(i);
+		short port = snapshot->ports.get(i);
 		memcpy(&addressOfThisMember.addr[0], &id, sizeof(int));
 		memcpy(&addressOfThisMember.addr[4], &port, sizeof(short));
-		curMemList.emplace_back(Node(addressOfThisMember));
+		for ( int v = 0; v < par->getVnodes(id); v++ ) {
+			curMemList.emplace_back(Node(addressOfThisMember, v));
+		}
 	}
 	return curMemList;
 }
@@ -93,9 +345,7 @@ vector<Node> MP2Node::getMembershipList() {
  * size_t position on the ring
  */
 size_t MP2Node::hashFunction(string key) {
-	std::hash<string> hashFunc;
-	size_t ret = hashFunc(key);
-	return ret%RING_SIZE;
+	return stableHash(key.data(), key.size());
 }
 
 /**
@@ -107,10 +357,8 @@ size_t MP2Node::hashFunction(string key) {
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
  */
-void MP2Node::clientCreate(string key, string value) {
-	/*
-	 * Implement this
-	 */
+void MP2Node::clientCreate(string key, string value, ConsistencyLevel level) {
+	dispatchMessages(Message(g_transID++, memberNode->addr, CREATE, key, value, PRIMARY), withMode(level, par->WRITE_MODE));
 }
 
 /**
@@ -122,10 +370,8 @@ void MP2Node::clientCreate(string key, string value) {
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
  */
-void MP2Node::clientRead(string key){
-	/*
-	 * Implement this
-	 */
+void MP2Node::clientRead(string key, ConsistencyLevel level){
+	dispatchMessages(Message(g_transID++, memberNode->addr, READ, key), withMode(level, par->READ_MODE));
 }
 
 /**
@@ -137,10 +383,8 @@ void MP2Node::clientRead(string key){
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
  */
-void MP2Node::clientUpdate(string key, string value){
-	/*
-	 * Implement this
-	 */
+void MP2Node::clientUpdate(string key, string value, ConsistencyLevel level){
+	dispatchMessages(Message(g_transID++, memberNode->addr, UPDATE, key, value, PRIMARY), withMode(level, par->WRITE_MODE));
 }
 
 /**
@@ -152,10 +396,138 @@ void MP2Node::clientUpdate(string key, string value){
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
  */
-void MP2Node::clientDelete(string key){
-	/*
-	 * Implement this
-	 */
+void MP2Node::clientDelete(string key, ConsistencyLevel level){
+	dispatchMessages(Message(g_transID++, memberNode->addr, DELETE, key), withMode(level, par->WRITE_MODE));
+}
+
+/**
+ * FUNCTION NAME: withMode
+ *
+ * DESCRIPTION: The consistency level of a client request: the one it asks for, else the
+ * 				one READ_MODE or WRITE_MODE sets for the tests
+ */
+ConsistencyLevel MP2Node::withMode(ConsistencyLevel level, int mode) {
+	if ( level != CONSISTENCY_DEFAULT ) {
+		return level;
+	}
+	switch ( mode ) {
+		case ONE_MODE:
+			return ONE;
+		case ALL_MODE:
+			return ALL;
+		case LOCAL_QUORUM_MODE:
+			return LOCAL_QUORUM;
+		default:
+			return CONSISTENCY_DEFAULT;
+	}
+}
+
+/**
+ * FUNCTION NAME: dispatchMessages
+ *
+ * DESCRIPTION: Coordinator side of every client request. Remembers the request until it
+ * 				gets the replies its consistency level asks for or times out, and sends it
+ * 				to each replica of the key tagged with that replica's position.
+ */
+void MP2Node::dispatchMessages(Message message, ConsistencyLevel level) {
+	vector<Node> replicas = findNodes(message.key);
+	loadStats.coordinated++;
+
+	Transaction &transaction = transactions[message.transID];
+	transaction.type = message.type;
+	transaction.key = message.key;
+	transaction.value = message.value;
+	transaction.clientTransID = message.transID;
+	transaction.epoch = ringEpoch;
+	transaction.redirects = 0;
+	transaction.dispatchedAt = par->getcurrtime();
+	transaction.level = level;
+	sendRequest(message.transID, transaction, replicas);
+}
+
+/**
+ * FUNCTION NAME: sendRequest
+ *
+ * DESCRIPTION: Send a request to the given replicas and start waiting for their replies
+ */
+void MP2Node::sendRequest(int transID, Transaction &transaction, vector<Node> &replicas) {
+	transaction.timestamp = par->getcurrtime();
+	transaction.replicas = replicas.size();
+	transaction.required = requiredReplies(transaction.type, transaction.level, replicas);
+	transaction.replies = 0;
+	transaction.successes = 0;
+	transaction.values.clear();
+	transaction.localReplicas = 0;
+	transaction.localReplies = 0;
+	transaction.localSuccesses = 0;
+	transaction.localValues.clear();
+	if ( transaction.level == LOCAL_QUORUM ) {
+		for ( unsigned int i = 0; i < replicas.size(); i++ ) {
+			transaction.localReplicas += inMyZone(replicas[i].nodeAddress);
+		}
+	}
+
+	Message message(transID, memberNode->addr, transaction.type, transaction.key, transaction.value);
+	for ( unsigned int i = 0; i < replicas.size(); i++ ) {
+		message.replica = static_cast<ReplicaType>(i);
+		send(replicas[i].getAddress(), message);
+	}
+}
+
+/**
+ * FUNCTION NAME: send
+ *
+ * DESCRIPTION: Send a message stamped with my ring epoch, returns its size in bytes
+ */
+size_t MP2Node::send(Address *to, Message &message) {
+	message.epoch = ringEpoch;
+	string data = message.toString();
+	emulNet->ENsend(&memberNode->addr, to, data);
+	return data.size();
+}
+
+/**
+ * FUNCTION NAME: requiredReplies
+ *
+ * DESCRIPTION: Successes a request needs: R for reads and W for writes unless the
+ * 				request asks for one, a majority or all of the N replicas, or a
+ * 				majority of the replicas in my zone. The request still goes to every
+ * 				replica, but only the replies from my zone count until they can no
+ * 				longer make the majority or LOCAL_QUORUM_TIMEOUT passes; then the
+ * 				others stand in for them. With no replica in my zone it needs a
+ * 				majority of all of them. With one replica in my zone, as zone aware
+ * 				placement gives when there are as many zones as replicas, the local
+ * 				majority is that replica and LOCAL_QUORUM behaves like ONE.
+ */
+int MP2Node::requiredReplies(MessageType type, ConsistencyLevel level, vector<Node> &replicas) {
+	int local = 0;
+	switch ( level ) {
+		case LOCAL_QUORUM:
+			for ( unsigned int i = 0; i < replicas.size(); i++ ) {
+				local += inMyZone(replicas[i].nodeAddress);
+			}
+			if ( local > 0 ) {
+				return local / 2 + 1;
+			}
+			return par->REPLICATION / 2 + 1;
+		case ONE:
+			return 1;
+		case QUORUM:
+			return par->REPLICATION / 2 + 1;
+		case ALL:
+			return par->REPLICATION;
+		default:
+			return type == READ ? par->READ_QUORUM : par->WRITE_QUORUM;
+	}
+}
+
+/**
+ * FUNCTION NAME: inMyZone
+ *
+ * DESCRIPTION: Whether a node is in the same zone as this node
+ */
+bool MP2Node::inMyZone(Address &address) {
+	return par->getZone(*(int *)address.addr) == par->getZone(*(int *)memberNode->addr.addr);
 }
 
 /**
@@ -167,10 +539,12 @@ void MP2Node::clientDelete(string key){
  * 			   	2) Return true or false based on success or failure
  */
 bool MP2Node::createKeyValue(string key, string value, ReplicaType replica) {
-	/*
-	 * Implement this
-	 */
 	// Insert key, value, replicaType into the hash table
+	if ( ht->count(key) ) {
+		return false;
+	}
+	keyIndex.insert(make_pair(hashFunction(key), key));
+	return ht->create(key, Entry(value, par->getcurrtime(), replica).convertToString());
 }
 
 /**
@@ -182,10 +556,12 @@ bool MP2Node::createKeyValue(string key, string value, ReplicaType replica) {
  * 			    2) Return value
  */
 string MP2Node::readKey(string key) {
-	/*
-	 * Implement this
-	 */
 	// Read key from local hash table and return value
+	string entry = ht->read(key);
+	if ( entry.empty() ) {
+		return "";
+	}
+	return Entry(entry).value;
 }
 
 /**
@@ -197,10 +573,8 @@ string MP2Node::readKey(string key) {
  * 				2) Return true or false based on success or failure
  */
 bool MP2Node::updateKeyValue(string key, string value, ReplicaType replica) {
-	/*
-	 * Implement this
-	 */
 	// Update key in local hash table and return true or false
+	return ht->update(key, Entry(value, par->getcurrtime(), replica).convertToString());
 }
 
 /**
@@ -212,10 +586,9 @@ bool MP2Node::updateKeyValue(string key, string value, ReplicaType replica) {
  * 				2) Return true or false based on success or failure
  */
 bool MP2Node::deletekey(string key) {
-	/*
-	 * Implement this
-	 */
 	// Delete the key from the local hash table
+	keyIndex.erase(make_pair(hashFunction(key), key));
+	return ht->deleteKey(key);
 }
 
 /**
@@ -227,15 +600,9 @@ bool MP2Node::deletekey(string key) {
  * 				2) Handles the messages according to message types
  */
 void MP2Node::checkMessages() {
-	/*
-	 * Implement this. Parts of it are already implemented
-	 */
 	char * data;
 	int size;
-
-	/*
-	 * Declare your local variables here
-	 */
+	Address *myAddr = &memberNode->addr;
 
 	// dequeue all messages and handle them
 	while ( !memberNode->mp2q.empty() ) {
@@ -246,50 +613,431 @@ void MP2Node::checkMessages() {
 		size = memberNode->mp2q.front().size;
 		memberNode->mp2q.pop();
 
-		string message(data, data + size);
+		string messageString(data, data + size);
+		free(data);
+		Message message(messageString);
 
 		/*
 		 * Handle the message types here
 		 */
-
+		switch ( message.type ) {
+			case CREATE: {
+				if ( message.transID <= STABILIZATION_TRANSID ) {
+					// Copy pushed by another replica, keep the value I already have
+					string entry = ht->read(message.key);
+					if ( entry.empty() ) {
+						createKeyValue(message.key, message.value, message.replica);
+					}
+					else {
+						Entry existing(entry);
+						existing.replica = message.replica;
+						ht->update(message.key, existing.convertToString());
+					}
+					Message reply(message.transID, *myAddr, REPLY, true);
+					send(&message.fromAddr, reply);
+					break;
+				}
+				if ( redirect(message) ) {
+					break;
+				}
+				loadStats.served[message.type]++;
+				bool success = createKeyValue(message.key, message.value, message.replica);
+				if ( success ) {
+					log->logCreateSuccess(myAddr, false, message.transID, message.key, message.value);
+				}
+				else {
+					log->logCreateFail(myAddr, false, message.transID, message.key, message.value);
+				}
+				Message reply(message.transID, *myAddr, REPLY, success);
+				send(&message.fromAddr, reply);
+				break;
+			}
+			case READ: {
+				if ( redirect(message) ) {
+					break;
+				}
+				loadStats.served[message.type]++;
+				string value = readKey(message.key);
+				if ( !value.empty() ) {
+					log->logReadSuccess(myAddr, false, message.transID, message.key, value);
+				}
+				else {
+					log->logReadFail(myAddr, false, message.transID, message.key);
+				}
+				Message reply(message.transID, *myAddr, value);
+				send(&message.fromAddr, reply);
+				break;
+			}
+			case UPDATE: {
+				if ( redirect(message) ) {
+					break;
+				}
+				loadStats.served[message.type]++;
+				bool success = updateKeyValue(message.key, message.value, message.replica);
+				if ( success ) {
+					log->logUpdateSuccess(myAddr, false, message.transID, message.key, message.value);
+				}
+				else {
+					log->logUpdateFail(myAddr, false, message.transID, message.key, message.value);
+				}
+				Message reply(message.transID, *myAddr, REPLY, success);
+				send(&message.fromAddr, reply);
+				break;
+			}
+			case DELETE: {
+				if ( redirect(message) ) {
+					break;
+				}
+				loadStats.served[message.type]++;
+				bool success = deletekey(message.key);
+				if ( success ) {
+					log->logDeleteSuccess(myAddr, false, message.transID, message.key);
+				}
+				else {
+					log->logDeleteFail(myAddr, false, message.transID, message.key);
+				}
+				Message reply(message.transID, *myAddr, REPLY, success);
+				send(&message.fromAddr, reply);
+				break;
+			}
+			case REPLY:
+				if ( message.transID <= STABILIZATION_TRANSID ) {
+					handleCopyReply(message);
+					break;
+				}
+				handleReply(message);
+				break;
+			case READREPLY:
+				handleReply(message);
+				break;
+			case REDIRECT:
+				handleRedirect(message);
+				break;
+		}
 	}
 
 	/*
 	 * This function should also ensure all READ and UPDATE operation
-	 * get QUORUM replies
+	 * get their quorum of replies
 	 */
+	map<int, Transaction>::iterator it = transactions.begin();
+	while ( it != transactions.end() ) {
+		int transID = it->first;
+		Transaction &transaction = it->second;
+		int age = par->getcurrtime() - transaction.timestamp;
+		bool expired = age > TRANSACTION_TIMEOUT;
+		bool succeeded = false;
+		if ( !expired && transaction.localReplicas > 0 && age > LOCAL_QUORUM_TIMEOUT ) {
+			// The replicas in my zone are too slow, the replies from the others count now
+			transaction.localReplicas = 0;
+			succeeded = transaction.successes >= transaction.required;
+		}
+		++it;
+		if ( expired || succeeded ) {
+			closeTransaction(transID, succeeded);
+		}
+	}
+
+	map<int, pair<string, int> >::iterator copy = copiesInFlight.begin();
+	while ( copy != copiesInFlight.end() ) {
+		int copyID = copy->first;
+		bool expired = par->getcurrtime() - copy->second.second > TRANSACTION_TIMEOUT;
+		++copy;
+		if ( expired ) {
+			copySettled(copyID, false);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: handleCopyReply
+ *
+ * DESCRIPTION: A replica acknowledged a copy pushed by the stabilization protocol
+ */
+void MP2Node::handleCopyReply(Message &message) {
+	if ( copiesInFlight.count(message.transID) ) {
+		copySettled(message.transID, message.success);
+	}
+}
+
+/**
+ * FUNCTION NAME: copySettled
+ *
+ * DESCRIPTION: Forget a copy in flight, acknowledged or timed out. Once every copy of a
+ * 				key is settled, the key is dropped if I am no longer one of its replicas
+ * 				and all of its copies were acknowledged. A key with a lost copy is kept
+ * 				until a later stabilization pushes it again.
+ */
+void MP2Node::copySettled(int copyID, bool acknowledged) {
+	string key = copiesInFlight[copyID].first;
+	copiesInFlight.erase(copyID);
+	if ( !acknowledged ) {
+		unconfirmedKeys.insert(key);
+	}
+	if ( --keyCopiesInFlight[key] > 0 ) {
+		return;
+	}
+	keyCopiesInFlight.erase(key);
+	if ( unconfirmedKeys.erase(key) ) {
+		return;
+	}
+	if ( hasKey(key) && !isReplicaFor(hashFunction(key)) ) {
+		deletekey(key);
+	}
+}
+
+/**
+ * FUNCTION NAME: handleReply
+ *
+ * DESCRIPTION: Count a replica's reply towards its transaction. A READ succeeds once the
+ * 				required number of replicas returned the same value. The transaction fails as
+ * 				soon as the replies still outstanding can no longer make that number.
+ * 				A LOCAL_QUORUM request counts only the replicas in my zone until they
+ * 				can no longer make the number, then the replies of every zone.
+ */
+void MP2Node::handleReply(Message &message) {
+	map<int, Transaction>::iterator it = transactions.find(message.transID);
+	if ( it == transactions.end() ) {
+		// Late reply to a request that is already closed
+		return;
+	}
+	Transaction &transaction = it->second;
+
+	transaction.replies++;
+	bool local = transaction.localReplicas > 0 && inMyZone(message.fromAddr);
+	if ( local ) {
+		transaction.localReplies++;
+	}
+	if ( message.type == READREPLY ) {
+		if ( !message.value.empty() ) {
+			int votes = ++transaction.values[message.value];
+			if ( votes > transaction.successes ) {
+				transaction.successes = votes;
+				transaction.value = message.value;
+			}
+			if ( local ) {
+				transaction.localSuccesses = max(transaction.localSuccesses, ++transaction.localValues[message.value]);
+			}
+		}
+	}
+	else if ( message.success ) {
+		transaction.successes++;
+		transaction.localSuccesses += local;
+	}
+
+	if ( transaction.localReplicas > 0 ) {
+		if ( transaction.localSuccesses >= transaction.required ) {
+			// This reply made the local majority
+			if ( message.type == READREPLY ) {
+				transaction.value = message.value;
+			}
+			closeTransaction(message.transID, true);
+			return;
+		}
+		if ( transaction.localSuccesses + transaction.localReplicas - transaction.localReplies >= transaction.required ) {
+			return;
+		}
+		// My zone can no longer make it, the other zones stand in
+		transaction.localReplicas = 0;
+	}
+
+	if ( transaction.successes >= transaction.required ) {
+		closeTransaction(message.transID, true);
+	}
+	else if ( transaction.successes + transaction.replicas - transaction.replies < transaction.required ) {
+		closeTransaction(message.transID, false);
+	}
+}
+
+/**
+ * FUNCTION NAME: redirect
+ *
+ * DESCRIPTION: Server side check of a client request against my ring. If the coordinator
+ * 				picked me from a ring with other members than mine and I am not a
+ * 				replica of the key in my ring, answer with its replicas in my ring
+ * 				instead of serving it. Rings cannot be ordered by how new they are,
+ * 				so MAX_REDIRECTS alone bounds how often a request is redirected.
+ *
+ * RETURNS:
+ * true if the request was redirected
+ */
+bool MP2Node::redirect(Message &message) {
+	if ( message.epoch == ringEpoch || isReplicaFor(hashFunction(message.key)) ) {
+		return false;
+	}
+	vector<Node> replicas = findNodes(message.key);
+	if ( replicas.empty() ) {
+		return false;
+	}
+	Message reply(message.transID, memberNode->addr, message.key, replicas);
+	send(&message.fromAddr, reply);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: handleRedirect
+ *
+ * DESCRIPTION: A replica answered with the replicas of the key in its ring. Resend the
+ * 				request to them under a new transaction id, so that replies still on
+ * 				the way from the first replicas are dropped, up to MAX_REDIRECTS times.
+ * 				A redirect from a ring with the same members as the one the request
+ * 				used, or past MAX_REDIRECTS, counts as a failed reply.
+ */
+void MP2Node::handleRedirect(Message &message) {
+	map<int, Transaction>::iterator it = transactions.find(message.transID);
+	if ( it == transactions.end() ) {
+		return;
+	}
+	if ( message.epoch == it->second.epoch || it->second.redirects >= MAX_REDIRECTS ) {
+		message.type = it->second.type == READ ? READREPLY : REPLY;
+		message.value = "";
+		message.success = false;
+		handleReply(message);
+		return;
+	}
+
+	Transaction transaction = it->second;
+	transactions.erase(it);
+	transaction.epoch = message.epoch;
+	transaction.redirects++;
+	vector<Node> replicas;
+	vector<Address> addresses = message.redirectReplicas();
+	for ( unsigned int i = 0; i < addresses.size(); i++ ) {
+		replicas.push_back(Node(addresses[i]));
+	}
+	int transID = g_transID++;
+	sendRequest(transID, transactions[transID] = transaction, replicas);
+}
+
+/**
+ * FUNCTION NAME: closeTransaction
+ *
+ * DESCRIPTION: Log the outcome of a request on the coordinator and forget it
+ */
+void MP2Node::closeTransaction(int transID, bool success) {
+	Transaction &transaction = transactions[transID];
+	Address *myAddr = &memberNode->addr;
+
+	if ( success ) {
+		loadStats.succeeded[transaction.type]++;
+		loadStats.closingSuccesses[transaction.type] += transaction.successes;
+		loadStats.closingReplies[transaction.type] += transaction.replies;
+	}
+	switch ( transaction.type ) {
+		case CREATE:
+			if ( success ) {
+				log->logCreateSuccess(myAddr, true, transaction.clientTransID, transaction.key, transaction.value);
+			}
+			else {
+				log->logCreateFail(myAddr, true, transaction.clientTransID, transaction.key, transaction.value);
+			}
+			break;
+		case READ:
+			if ( success ) {
+				loadStats.reads++;
+				loadStats.readPeriods += par->getcurrtime() - transaction.dispatchedAt;
+				log->logReadSuccess(myAddr, true, transaction.clientTransID, transaction.key, transaction.value);
+			}
+			else {
+				log->logReadFail(myAddr, true, transaction.clientTransID, transaction.key);
+			}
+			break;
+		case UPDATE:
+			if ( success ) {
+				log->logUpdateSuccess(myAddr, true, transaction.clientTransID, transaction.key, transaction.value);
+			}
+			else {
+				log->logUpdateFail(myAddr, true, transaction.clientTransID, transaction.key, transaction.value);
+			}
+			break;
+		case DELETE:
+			if ( success ) {
+				log->logDeleteSuccess(myAddr, true, transaction.clientTransID, transaction.key);
+			}
+			else {
+				log->logDeleteFail(myAddr, true, transaction.clientTransID, transaction.key);
+			}
+			break;
+		default:
+			break;
+	}
+	transactions.erase(transID);
 }
 
 /**
  * FUNCTION NAME: findNodes
  *
  * DESCRIPTION: Find the replicas of the given keyfunction
- * 				This function is responsible for finding the replicas of a key
+ * 				This function is responsible for finding the REPLICATION physical
+ * 				nodes that hold a key, as placed by the configured strategy
  */
 vector<Node> MP2Node::findNodes(string key) {
 	size_t pos = hashFunction(key);
 	vector<Node> addr_vec;
-	if (ring.size() >= 3) {
-		// if pos <= min || pos > max, the leader is the min
-		if (pos <= ring.at(0).getHashCode() || pos > ring.at(ring.size()-1).getHashCode()) {
-			addr_vec.emplace_back(ring.at(0));
-			addr_vec.emplace_back(ring.at(1));
-			addr_vec.emplace_back(ring.at(2));
-		}
-		else {
-			// go through the ring until pos <= node
-			for (int i=1; i<ring.size(); i++){
-				Node addr = ring.at(i);
-				if (pos <= addr.getHashCode()) {
-					addr_vec.emplace_back(addr);
-					addr_vec.emplace_back(ring.at((i+1)%ring.size()));
-					addr_vec.emplace_back(ring.at((i+2)%ring.size()));
-					break;
-				}
+	ring->replicasOf(pos, par->REPLICATION, addr_vec);
+	if ((int)addr_vec.size() < par->REPLICATION) {
+		addr_vec.clear();
+	}
+	return addr_vec;
+}
+
+/**
+ * FUNCTION NAME: findNodesBatch
+ *
+ * DESCRIPTION: findNodes for many keys. The keys are hashed in one pass, keys with the
+ * 				same owner share one walk of the ring, and their replicas are grouped
+ * 				by node, in the order the nodes are first met. Keys that have fewer
+ * 				than REPLICATION replicas are left out, as findNodes returns none.
+ */
+vector<ReplicaBatch> MP2Node::findNodesBatch(const vector<string> &keys) {
+	vector<ReplicaBatch> batches;
+	unsigned int count = ring->setSize(par->REPLICATION);
+	if ( (int)count < par->REPLICATION ) {
+		return batches;
+	}
+	vector<size_t> positions(keys.size());
+	for ( unsigned int k = 0; k < keys.size(); k++ ) {
+		positions[k] = hashFunction(keys[k]);
+	}
+
+	vector<unsigned int> setOf;
+	vector<Node> sets;
+	ring->replicasOfMany(positions, par->REPLICATION, setOf, sets);
+
+	map<unsigned long, unsigned int> batchOf;
+	for ( unsigned int k = 0; k < setOf.size(); k++ ) {
+		Node *replicas = &sets[setOf[k] * count];
+		for ( unsigned int i = 0; i < count; i++ ) {
+			unsigned long address = Ring::toEntry(replicas[i]).address();
+			map<unsigned long, unsigned int>::iterator it = batchOf.find(address);
+			if ( it == batchOf.end() ) {
+				it = batchOf.insert(make_pair(address, batches.size())).first;
+				batches.push_back(ReplicaBatch());
+				batches.back().node = replicas[i];
 			}
+			batches[it->second].keys.push_back(keys[k]);
+			batches[it->second].replicas.push_back(static_cast<ReplicaType>(i));
 		}
 	}
-	return addr_vec;
+	return batches;
+}
+
+/**
+ * FUNCTION NAME: storedLoad
+ *
+ * DESCRIPTION: Count the keys of the hash table by replica type, byReplica[t] for type t,
+ * 				and the bytes of their keys and entries
+ */
+void MP2Node::storedLoad(vector<int> &byReplica, long &bytes) {
+	byReplica.assign(par->REPLICATION, 0);
+	bytes = 0;
+	for ( map<string, string>::iterator it = ht->hashTable.begin(); it != ht->hashTable.end(); ++it ) {
+		Entry entry(it->second);
+		if ( entry.replica >= 0 && entry.replica < (int)byReplica.size() ) {
+			byReplica[entry.replica]++;
+		}
+		bytes += it->first.size() + it->second.size();
+	}
 }
 
 /**
@@ -323,9 +1071,126 @@ int MP2Node::enqueueWrapper(void *env, char *buff, int size) {
  * 				The function does the following:
  *				1) Ensures that there are three "CORRECT" replicas of all the keys in spite of failures and joins
  *				Note:- "CORRECT" replicas implies that every key is replicated in its two neighboring nodes in the ring
+ *				Only the keys in changedRanges are visited, all of them if wholeRingChanged.
  */
 void MP2Node::stabilizationProtocol() {
-	/*
-	 * Implement this
-	 */
+	vector<string> keys;
+
+	if ( wholeRingChanged ) {
+		for ( set<pair<size_t, string> >::iterator it = keyIndex.begin(); it != keyIndex.end(); ++it ) {
+			keys.push_back(it->second);
+		}
+	}
+	else {
+		for ( unsigned int i = 0; i < changedRanges.size(); i++ ) {
+			keysInRange(changedRanges[i].first, changedRanges[i].second, keys);
+		}
+		// Ranges of several changes may overlap
+		sort(keys.begin(), keys.end());
+		keys.erase(unique(keys.begin(), keys.end()), keys.end());
+	}
+
+	stabStats.runs++;
+	stabStats.keysVisited += keys.size();
+	vector<ReplicaBatch> batches = findNodesBatch(keys);
+	for ( unsigned int b = 0; b < batches.size(); b++ ) {
+		ReplicaBatch &batch = batches[b];
+		for ( unsigned int k = 0; k < batch.keys.size(); k++ ) {
+			Entry entry(ht->read(batch.keys[k]));
+			if ( isMe(batch.node) ) {
+				entry.replica = batch.replicas[k];
+				ht->update(batch.keys[k], entry.convertToString());
+			}
+			else {
+				// Push the key to the other replicas, whether or not they already have it.
+				// A key that moved to other nodes is dropped once they all acknowledged it.
+				sendReplica(batch.node, batch.keys[k], entry.value, batch.replicas[k]);
+			}
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: keysInRange
+ *
+ * DESCRIPTION: Append the keys of the hash table at positions in (start, end], the range
+ * 				wrapping past the top of the ring if start >= end
+ */
+void MP2Node::keysInRange(size_t start, size_t end, vector<string> &keys) {
+	set<pair<size_t, string> >::iterator it = keyIndex.lower_bound(make_pair(start, string()));
+	while ( it != keyIndex.end() && it->first == start ) {
+		++it;
+	}
+	if ( start >= end ) {
+		// Up to the top of the ring, then from the bottom
+		for ( ; it != keyIndex.end(); ++it ) {
+			keys.push_back(it->second);
+		}
+		it = keyIndex.begin();
+	}
+	for ( ; it != keyIndex.end() && it->first <= end; ++it ) {
+		keys.push_back(it->second);
+	}
+}
+
+/**
+ * FUNCTION NAME: handOffKeys
+ *
+ * DESCRIPTION: Called when this node leaves the ring on purpose, before it goes away.
+ * 				Each key is sent to the nodes that become its replicas once I am out of
+ * 				the ring and did not hold it before, so the key is back to full
+ * 				replication without waiting for the failure detector.
+ */
+void MP2Node::handOffKeys() {
+	vector<string> keys;
+	for ( map<string, string>::iterator it = ht->hashTable.begin(); it != ht->hashTable.end(); ++it ) {
+		keys.push_back(it->first);
+	}
+	set<pair<string, string> > held;
+	vector<ReplicaBatch> before = findNodesBatch(keys);
+	for ( unsigned int b = 0; b < before.size(); b++ ) {
+		for ( unsigned int k = 0; k < before[b].keys.size(); k++ ) {
+			held.insert(make_pair(before[b].node.getAddress()->getAddress(), before[b].keys[k]));
+		}
+	}
+
+	// The ring as the others will see it once they got my LEAVE, private to me
+	Ring *left = new Ring(*ring);
+	left->eraseMember(memberNode->addr, par->getVnodes(*(int *)(&memberNode->addr.addr)));
+	ring = Ring::intern(RingView(), left);
+
+	vector<ReplicaBatch> after = findNodesBatch(keys);
+	for ( unsigned int b = 0; b < after.size(); b++ ) {
+		ReplicaBatch &batch = after[b];
+		for ( unsigned int k = 0; k < batch.keys.size(); k++ ) {
+			if ( !held.count(make_pair(batch.node.getAddress()->getAddress(), batch.keys[k])) ) {
+				sendReplica(batch.node, batch.keys[k], Entry(ht->read(batch.keys[k])).value, batch.replicas[k]);
+			}
+		}
+	}
+	ht->clear();
+	keyIndex.clear();
+}
+
+/**
+ * FUNCTION NAME: sendReplica
+ *
+ * DESCRIPTION: Push a copy of a key to one of its replicas and wait for its acknowledgement
+ */
+void MP2Node::sendReplica(Node &replica, string key, string value, ReplicaType type) {
+	int copyID = nextCopyID--;
+	copiesInFlight[copyID] = make_pair(key, par->getcurrtime());
+	keyCopiesInFlight[key]++;
+	Message message(copyID, memberNode->addr, CREATE, key, value, type);
+	stabStats.replicasSent++;
+	stabStats.bytesSent += send(replica.getAddress(), message);
+}
+
+/**
+ * FUNCTION NAME: isMe
+ *
+ * DESCRIPTION: Returns true if the ring node is this node
+ */
+bool MP2Node::isMe(Node &node) {
+	return *node.getAddress() == memberNode->addr;
 }
@@ -13,12 +13,106 @@
 #include "stdincludes.h"
 #include "EmulNet.h"
 #include "Node.h"
+#include "Ring.h"
 #include "HashTable.h"
 #include "Log.h"
 #include "Params.h"
 #include "Message.h"
 #include "Queue.h"
 
+/**
+ * Macros
+ */
+// periods a coordinator waits for its quorum of replies before reporting failure
+#define TRANSACTION_TIMEOUT 10
+// transaction ids of the CREATEs replicas send each other count down from this one, these
+// are not logged and are acknowledged with a REPLY
+#define STABILIZATION_TRANSID -1
+// times a request follows a redirect to the replicas of a newer ring before it gives up
+#define MAX_REDIRECTS 2
+// periods a LOCAL_QUORUM request waits on the replicas in its zone before the others count
+#define LOCAL_QUORUM_TIMEOUT 5
+
+/**
+ * STRUCT NAME: Transaction
+ *
+ * DESCRIPTION: Client request a coordinator is waiting on replies for
+ */
+typedef struct Transaction {
+	MessageType type;
+	string key;
+	string value;
+	ConsistencyLevel level;
+	// transaction id the client request is logged under, the request is resent under new ones
+	int clientTransID;
+	// ring epoch the replicas were picked from, and redirects followed so far
+	int epoch;
+	int redirects;
+	// time the request was dispatched, and resent after a redirect
+	int dispatchedAt;
+	int timestamp;
+	// replicas the request was sent to
+	int replicas;
+	// successes needed to report success to the client
+	int required;
+	int replies;
+	int successes;
+	// READ only: number of replicas that returned each value
+	map<string, int> values;
+	// LOCAL_QUORUM only: replicas in my zone, 0 once replies from every zone count,
+	// and their replies, successes and values
+	int localReplicas;
+	int localReplies;
+	int localSuccesses;
+	map<string, int> localValues;
+} Transaction;
+
+/**
+ * STRUCT NAME: ReplicaBatch
+ *
+ * DESCRIPTION: Keys that have a replica on one node, and which replica each of them is there
+ */
+typedef struct ReplicaBatch {
+	Node node;
+	vector<string> keys;
+	vector<ReplicaType> replicas;
+} ReplicaBatch;
+
+/**
+ * STRUCT NAME: StabilizationStats
+ *
+ * DESCRIPTION: Counters kept by the stabilization protocol and the hand-off of a node
+ */
+typedef struct StabilizationStats {
+	// stabilization protocol runs
+	long runs;
+	// local keys those runs looked up
+	long keysVisited;
+	// replicas pushed to other nodes, and the bytes of their messages
+	long replicasSent;
+	long bytesSent;
+} StabilizationStats;
+
+/**
+ * STRUCT NAME: LoadStats
+ *
+ * DESCRIPTION: Client requests handled by a node
+ */
+typedef struct LoadStats {
+	// requests served as a replica, by type from CREATE to DELETE
+	long served[DELETE + 1];
+	// requests coordinated
+	long coordinated;
+	// reads that succeeded, and the periods they took from dispatch to quorum
+	long reads;
+	long readPeriods;
+	// requests coordinated that succeeded, by type from CREATE to DELETE, and the
+	// successes and replies they had when they closed
+	long succeeded[DELETE + 1];
+	long closingSuccesses[DELETE + 1];
+	long closingReplies[DELETE + 1];
+} LoadStats;
+
 /**
  * CLASS NAME: MP2Node
  *
@@ -31,14 +125,36 @@
  */
 class MP2Node {
 private:
-	// Vector holding the next two neighbors in the ring who have my replicas
+	// Vector holding the next REPLICATION - 1 neighbors in the ring who have my replicas
 	vector<Node> hasMyReplicas;
-	// Vector holding the previous two neighbors in the ring whose replicas I have
+	// Vector holding the previous REPLICATION - 1 neighbors in the ring whose replicas I have
 	vector<Node> haveReplicasOf;
-	// Ring
-	vector<Node> ring;
+	// Ranges (start, end] of the positions of the keys I hold a replica of, kept with the neighbors
+	vector<pair<size_t, size_t> > replicaRanges;
+	// I hold a replica of every key
+	bool replicaOfAll;
+	// The placement has neighbors, else the two vectors and the ranges are empty
+	bool neighborsKnown;
+	// My positions on the ring
+	vector<size_t> myPositions;
+	// Ring, shared with the nodes that have the same view of the membership
+	shared_ptr<const Ring> ring;
+	// Membership version the ring was last built from
+	long ringVersion;
+	// Hash of the members of the ring, sent with every message to tell whether two rings differ
+	int ringEpoch;
+	// Reader slot of this node in memberNode->membership
+	int snapshotReader;
 	// Hash Table
 	HashTable * ht;
+	// Keys of the hash table by ring position, so that stabilization visits only the ranges that changed
+	set<pair<size_t, string> > keyIndex;
+	// Ranges (start, end] of positions whose replicas changed since the last stabilization, wrapping if start >= end
+	vector<pair<size_t, size_t> > changedRanges;
+	// The replicas of any key may have changed
+	bool wholeRingChanged;
+	// A node joined or left next to one of my positions since the last stabilization
+	bool neighborsTouched;
 	// Member representing this member
 	Member *memberNode;
 	// Params object
@@ -47,8 +163,34 @@ private:
 	EmulNet * emulNet;
 	// Object of Log
 	Log * log;
+	// Requests this node coordinates, by transaction id
+	map<int, Transaction> transactions;
+	// Copies pushed to other replicas and not acknowledged yet: key and time sent, by transaction id
+	map<int, pair<string, int> > copiesInFlight;
+	// Copies in flight of each key, and the keys one of whose copies got no acknowledgement
+	map<string, int> keyCopiesInFlight;
+	set<string> unconfirmedKeys;
+	// Transaction id of the next copy
+	int nextCopyID;
+
+	void handleReply(Message &message);
+	void handleCopyReply(Message &message);
+	void copySettled(int copyID, bool acknowledged);
+	void handleRedirect(Message &message);
+	bool redirect(Message &message);
+	size_t send(Address *to, Message &message);
+	void sendRequest(int transID, Transaction &transaction, vector<Node> &replicas);
+	void closeTransaction(int transID, bool success);
+	void sendReplica(Node &replica, string key, string value, ReplicaType type);
+	bool isMe(Node &node);
+	void keysInRange(size_t start, size_t end, vector<string> &keys);
+	bool nearMe(unsigned int firstRange);
+	void noteChangedRanges(const Ring &on, Address &address, int vnodes);
 
 public:
+	StabilizationStats stabStats;
+	LoadStats loadStats;
+
 	MP2Node(Member *memberNode, Params *par, EmulNet *emulNet, Log *log, Address *addressOfMember);
 	Member * getMemberNode() {
 		return this->memberNode;
@@ -56,15 +198,20 @@ public:
 
 	// ring functionalities
 	void updateRing();
-	vector<Node> getMembershipList();
+	bool patchRing(const MembershipSnapshot *snapshot, const RingView &view);
+	shared_ptr<const Ring> getRing() {
+		return ring;
+	}
+	vector<Node> getMembershipList(const MembershipSnapshot *snapshot);
 	size_t hashFunction(string key);
-	void findNeighbors();
+	bool findNeighbors();
+	bool isReplicaFor(size_t pos);
 
 	// client side CRUD APIs
-	void clientCreate(string key, string value);
-	void clientRead(string key);
-	void clientUpdate(string key, string value);
-	void clientDelete(string key);
+	void clientCreate(string key, string value, ConsistencyLevel level = CONSISTENCY_DEFAULT);
+	void clientRead(string key, ConsistencyLevel level = CONSISTENCY_DEFAULT);
+	void clientUpdate(string key, string value, ConsistencyLevel level = CONSISTENCY_DEFAULT);
+	void clientDelete(string key, ConsistencyLevel level = CONSISTENCY_DEFAULT);
 
 	// receive messages from Emulnet
 	bool recvLoop();
@@ -74,10 +221,23 @@ public:
 	void checkMessages();
 
 	// coordinator dispatches messages to corresponding nodes
-	void dispatchMessages(Message message);
+	void dispatchMessages(Message message, ConsistencyLevel level = CONSISTENCY_DEFAULT);
+	// successes a request of the given type needs at the given consistency level
+	int requiredReplies(MessageType type, ConsistencyLevel level, vector<Node> &replicas);
+	// the level a client request asks for, else the one of the given READ_MODE or WRITE_MODE
+	ConsistencyLevel withMode(ConsistencyLevel level, int mode);
+	// whether a node is in the zone of this node
+	bool inMyZone(Address &address);
 
 	// find the addresses of nodes that are responsible for a key
 	vector<Node> findNodes(string key);
+	// the same for many keys, grouped by the node the replicas go to
+	vector<ReplicaBatch> findNodesBatch(const vector<string> &keys);
+	bool hasKey(string key) {
+		return ht->count(key) > 0;
+	}
+	// keys held, by replica type, and bytes of the keys and entries held
+	void storedLoad(vector<int> &byReplica, long &bytes);
 
 	// server
 	bool createKeyValue(string key, string value, ReplicaType replica);
@@ -87,6 +247,8 @@ public:
 
 	// stabilization protocol - handle multiple failures
 	void stabilizationProtocol();
+	// hand my keys over to the nodes that own them once I am gone
+	void handOffKeys();
 
 	~MP2Node();
 };
@@ -38,12 +38,12 @@ bool Address::operator ==(const Address& anotherAddress) {
 /**
  * Constructor
  */
-MemberListEntry::MemberListEntry(int id, short port, long heartbeat, long timestamp): id(id), port(port), heartbeat(heartbeat), timestamp(timestamp) {}
+MemberListEntry::MemberListEntry(int id, short port, long heartbeat, long timestamp): id(id), port(port), heartbeat(heartbeat), timestamp(timestamp), incarnation(0), state(MEMBER_ALIVE) {}
 
 /**
  * Constuctor
  */
-MemberListEntry::MemberListEntry(int id, short port): id(id), port(port) {}
+MemberListEntry::MemberListEntry(int id, short port): id(id), port(port), heartbeat(0), timestamp(0), incarnation(0), state(MEMBER_ALIVE) {}
 
 /**
  * Copy constructor
@@ -53,6 +53,8 @@ MemberListEntry::MemberListEntry(const MemberListEntry &anotherMLE) {
 	this->id = anotherMLE.id;
 	this->port = anotherMLE.port;
 	this->timestamp = anotherMLE.timestamp;
+	this->incarnation = anotherMLE.incarnation;
+	this->state = anotherMLE.state;
 }
 
 /**
@@ -64,6 +66,8 @@ MemberListEntry& MemberListEntry::operator =(const MemberListEntry &anotherMLE)
 	swap(id, temp.id);
 	swap(port, temp.port);
 	swap(timestamp, temp.timestamp);
+	swap(incarnation, temp.incarnation);
+	swap(state, temp.state);
 	return *this;
 }
 
@@ -139,8 +143,412 @@ void MemberListEntry::settimestamp(long timestamp) {
 	this->timestamp = timestamp;
 }
 
+/**
+ * FUNCTION NAME: getincarnation
+ *
+ * DESCRIPTION: getter
+ */
+long MemberListEntry::getincarnation() {
+	return incarnation;
+}
+
+/**
+ * FUNCTION NAME: getstate
+ *
+ * DESCRIPTION: getter
+ */
+MemberState MemberListEntry::getstate() {
+	return state;
+}
+
+/**
+ * FUNCTION NAME: setincarnation
+ *
+ * DESCRIPTION: setter
+ */
+void MemberListEntry::setincarnation(long incarnation) {
+	this->incarnation = incarnation;
+}
+
+/**
+ * FUNCTION NAME: setstate
+ *
+ * DESCRIPTION: setter
+ */
+void MemberListEntry::setstate(MemberState state) {
+	this->state = state;
+}
+
+/**
+ * FUNCTION NAME: getid
+ *
+ * DESCRIPTION: getter
+ */
+int MemberView::getid() {
+	return table->ids.get(row);
+}
+
+/**
+ * FUNCTION NAME: getport
+ *
+ * DESCRIPTION: getter
+ */
+short MemberView::getport() {
+	return table->ports.get(row);
+}
+
+/**
+ * FUNCTION NAME: getheartbeat
+ *
+ * DESCRIPTION: getter
+ */
+long MemberView::getheartbeat() {
+	return table->heartbeats[row];
+}
+
+/**
+ * FUNCTION NAME: gettimestamp
+ *
+ * DESCRIPTION: getter
+ */
+long MemberView::gettimestamp() {
+	return table->timestamps[row];
+}
+
+/**
+ * FUNCTION NAME: getincarnation
+ *
+ * DESCRIPTION: getter
+ */
+long MemberView::getincarnation() {
+	return table->incarnations.get(row);
+}
+
+/**
+ * FUNCTION NAME: getstate
+ *
+ * DESCRIPTION: getter
+ */
+MemberState MemberView::getstate() {
+	return static_cast<MemberState>(table->states.get(row));
+}
+
+/**
+ * FUNCTION NAME: setheartbeat
+ *
+ * DESCRIPTION: setter
+ */
+void MemberView::setheartbeat(long heartbeat) {
+	table->heartbeats[row] = heartbeat;
+}
+
+/**
+ * FUNCTION NAME: settimestamp
+ *
+ * DESCRIPTION: setter
+ */
+void MemberView::settimestamp(long timestamp) {
+	table->timestamps[row] = (int)timestamp;
+}
+
+/**
+ * FUNCTION NAME: setincarnation
+ *
+ * DESCRIPTION: setter
+ */
+void MemberView::setincarnation(long incarnation) {
+	table->incarnations.set(row, incarnation);
+}
+
+/**
+ * FUNCTION NAME: setstate
+ *
+ * DESCRIPTION: setter
+ */
+void MemberView::setstate(MemberState state) {
+	table->states.set(row, (unsigned char)state);
+}
+
+/**
+ * FUNCTION NAME: entry
+ *
+ * DESCRIPTION: Copy the row out of the table
+ */
+MemberListEntry MemberView::entry() {
+	MemberListEntry entry(getid(), getport(), getheartbeat(), gettimestamp());
+	entry.setincarnation(getincarnation());
+	entry.setstate(getstate());
+	return entry;
+}
+
+/**
+ * FUNCTION NAME: insert
+ *
+ * DESCRIPTION: Add a row, keeping the rows sorted by id
+ */
+unsigned int MemberTable::insert(const MemberListEntry &entry) {
+	unsigned int low = 0, high = size();
+	while ( low < high ) {
+		unsigned int mid = (low + high) / 2;
+		if ( ids.get(mid) < entry.id ) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	ids.edit().insert(ids.edit().begin() + low, entry.id);
+	ports.edit().insert(ports.edit().begin() + low, entry.port);
+	incarnations.edit().insert(incarnations.edit().begin() + low, entry.incarnation);
+	states.edit().insert(states.edit().begin() + low, (unsigned char)entry.state);
+	heartbeats.insert(heartbeats.begin() + low, entry.heartbeat);
+	timestamps.insert(timestamps.begin() + low, (int)entry.timestamp);
+	return low;
+}
+
+/**
+ * FUNCTION NAME: find
+ *
+ * DESCRIPTION: Binary search of the row of a member id
+ */
+int MemberTable::find(int id) {
+	int low = 0, high = (int)size() - 1;
+	while ( low <= high ) {
+		int mid = (low + high) / 2;
+		int midId = ids.get(mid);
+		if ( midId == id ) {
+			return mid;
+		}
+		if ( midId < id ) {
+			low = mid + 1;
+		}
+		else {
+			high = mid - 1;
+		}
+	}
+	return -1;
+}
+
+/**
+ * FUNCTION NAME: erase
+ *
+ * DESCRIPTION: Remove a row, keeping the order of the others
+ */
+void MemberTable::erase(unsigned int row) {
+	ids.edit().erase(ids.edit().begin() + row);
+	ports.edit().erase(ports.edit().begin() + row);
+	incarnations.edit().erase(incarnations.edit().begin() + row);
+	states.edit().erase(states.edit().begin() + row);
+	heartbeats.erase(heartbeats.begin() + row);
+	timestamps.erase(timestamps.begin() + row);
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Remove all rows
+ */
+void MemberTable::clear() {
+	ids.edit().clear();
+	ports.edit().clear();
+	incarnations.edit().clear();
+	states.edit().clear();
+	heartbeats.clear();
+	timestamps.clear();
+	freeze();
+}
+
+/**
+ * FUNCTION NAME: freeze
+ *
+ * DESCRIPTION: Turn the shared columns written since the last freeze back into
+ * 				interned chunks. Called once a period, reads work either way.
+ */
+void MemberTable::freeze() {
+	ids.freeze();
+	ports.freeze();
+	incarnations.freeze();
+	states.freeze();
+}
+
+/**
+ * FUNCTION NAME: memoryUsage
+ *
+ * DESCRIPTION: Add up the bytes held by this table alone, and its share of the
+ * 				chunks it holds together with other tables
+ */
+void MemberTable::memoryUsage(size_t &privateBytes, double &sharedBytes) {
+	ids.memoryUsage(privateBytes, sharedBytes);
+	ports.memoryUsage(privateBytes, sharedBytes);
+	incarnations.memoryUsage(privateBytes, sharedBytes);
+	states.memoryUsage(privateBytes, sharedBytes);
+	privateBytes += heartbeats.capacity() * sizeof(long) + timestamps.capacity() * sizeof(int);
+}
+
+/**
+ * FUNCTION NAME: entries
+ *
+ * DESCRIPTION: Copy the table out as entries
+ */
+vector<MemberListEntry> MemberTable::entries() {
+	vector<MemberListEntry> out;
+	out.reserve(size());
+	for ( unsigned int i = 0; i < size(); i++ ) {
+		out.push_back((*this)[i].entry());
+	}
+	return out;
+}
+
+/**
+ * FUNCTION NAME: updatedBefore
+ *
+ * DESCRIPTION: Collect the rows whose last update is older than tick, in increasing order.
+ * 				With SSE2 the tick column is compared four rows at a time and only the
+ * 				rows set in the compare mask are looked at.
+ */
+void MemberTable::updatedBefore(int tick, vector<unsigned int> &rows) {
+	const int *column = timestamps.data();
+	unsigned int n = timestamps.size();
+	unsigned int i = 0;
+
+	rows.clear();
+#ifdef __SSE2__
+	__m128i limit = _mm_set1_epi32(tick);
+	for ( ; i + 4 <= n; i += 4 ) {
+		__m128i ticks = _mm_loadu_si128((const __m128i *)(column + i));
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(limit, ticks)));
+		while ( mask ) {
+			int bit = __builtin_ctz(mask);
+			rows.push_back(i + bit);
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for ( ; i < n; i++ ) {
+		if ( column[i] < tick ) {
+			rows.push_back(i);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: SnapshotPublisher
+ *
+ * DESCRIPTION: Constructor. Epochs start at 1, 0 marks an idle reader.
+ */
+SnapshotPublisher::SnapshotPublisher(): current(NULL), epoch(1) {
+	for ( int i = 0; i < MAX_SNAPSHOT_READERS; i++ ) {
+		readers[i].store(0);
+		registered[i].store(false);
+	}
+}
+
+/**
+ * Destructor
+ */
+SnapshotPublisher::~SnapshotPublisher() {
+	delete current.load();
+	for ( unsigned int i = 0; i < retired.size(); i++ ) {
+		delete retired[i].second;
+	}
+}
+
+/**
+ * FUNCTION NAME: publish
+ *
+ * DESCRIPTION: Swap in a new snapshot, then end the epoch the old one was current in
+ */
+void SnapshotPublisher::publish(const MembershipSnapshot *snapshot) {
+	const MembershipSnapshot *old = current.exchange(snapshot);
+	// Readers entering after the bump can only load the new snapshot
+	unsigned long replacedIn = epoch.fetch_add(1);
+	if ( old ) {
+		retired.push_back(make_pair(replacedIn, old));
+	}
+	reclaim();
+}
+
+/**
+ * FUNCTION NAME: reclaim
+ *
+ * DESCRIPTION: Free the replaced snapshots no reader can hold any more. A reader that
+ * 				entered in epoch e may hold a snapshot replaced in e or later.
+ */
+void SnapshotPublisher::reclaim() {
+	unsigned long oldest = epoch.load();
+	for ( int i = 0; i < MAX_SNAPSHOT_READERS; i++ ) {
+		unsigned long entered = readers[i].load();
+		if ( entered != 0 && entered < oldest ) {
+			oldest = entered;
+		}
+	}
+	for ( unsigned int i = 0; i < retired.size(); ) {
+		if ( retired[i].first < oldest ) {
+			delete retired[i].second;
+			retired[i] = retired.back();
+			retired.pop_back();
+		}
+		else {
+			i++;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: registerReader
+ *
+ * DESCRIPTION: Hand out a free reader slot, -1 if all MAX_SNAPSHOT_READERS are taken
+ */
+int SnapshotPublisher::registerReader() {
+	for ( int i = 0; i < MAX_SNAPSHOT_READERS; i++ ) {
+		bool free = false;
+		if ( registered[i].compare_exchange_strong(free, true) ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * FUNCTION NAME: unregisterReader
+ *
+ * DESCRIPTION: Leave the epoch and free the reader slot for another reader
+ */
+void SnapshotPublisher::unregisterReader(int reader) {
+	if ( reader >= 0 && reader < MAX_SNAPSHOT_READERS ) {
+		readers[reader].store(0);
+		registered[reader].store(false);
+	}
+}
+
+/**
+ * FUNCTION NAME: acquire
+ *
+ * DESCRIPTION: Enter the current epoch and load the current snapshot. The epoch is
+ * 				announced before the load, so the writer cannot free what is loaded.
+ */
+const MembershipSnapshot *SnapshotPublisher::acquire(int reader) {
+	if ( reader < 0 || reader >= MAX_SNAPSHOT_READERS ) {
+		return NULL;
+	}
+	readers[reader].store(epoch.load());
+	return current.load();
+}
+
+/**
+ * FUNCTION NAME: release
+ *
+ * DESCRIPTION: Leave the epoch, the snapshot acquired may be freed from now on
+ */
+void SnapshotPublisher::release(int reader) {
+	if ( reader >= 0 && reader < MAX_SNAPSHOT_READERS ) {
+		readers[reader].store(0);
+	}
+}
+
 /**
  * Copy Constructor
+ * The copy publishes nothing until its own MP1 does.
  */
 Member::Member(const Member &anotherMember) {
 	this->addr = anotherMember.addr;
@@ -149,10 +557,12 @@ Member::Member(const Member &anotherMember) {
 	this->bFailed = anotherMember.bFailed;
 	this->nnb = anotherMember.nnb;
 	this->heartbeat = anotherMember.heartbeat;
+	this->incarnation = anotherMember.incarnation;
 	this->pingCounter = anotherMember.pingCounter;
 	this->timeOutCounter = anotherMember.timeOutCounter;
 	this->memberList = anotherMember.memberList;
 	this->myPos = anotherMember.myPos;
+	this->membershipVersion = anotherMember.membershipVersion;
 	this->mp1q = anotherMember.mp1q;
 	this->mp2q = anotherMember.mp2q;
 }
@@ -167,10 +577,12 @@ Member& Member::operator =(const Member& anotherMember) {
 	this->bFailed = anotherMember.bFailed;
 	this->nnb = anotherMember.nnb;
 	this->heartbeat = anotherMember.heartbeat;
+	this->incarnation = anotherMember.incarnation;
 	this->pingCounter = anotherMember.pingCounter;
 	this->timeOutCounter = anotherMember.timeOutCounter;
 	this->memberList = anotherMember.memberList;
 	this->myPos = anotherMember.myPos;
+	this->membershipVersion = anotherMember.membershipVersion;
 	this->mp1q = anotherMember.mp1q;
 	this->mp2q = anotherMember.mp2q;
 	return *this;
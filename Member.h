@@ -9,6 +9,16 @@
 
 #include "stdincludes.h"
 
+/*
+ * Macros
+ */
+// membership events kept between two snapshots, a snapshot without them is rebuilt from scratch
+#define MAX_MEMBERSHIP_EVENTS 1024
+// rows per chunk of the shared membership table columns
+#define MEMBER_CHUNK_ROWS 64
+// readers a SnapshotPublisher can serve at the same time
+#define MAX_SNAPSHOT_READERS 4
+
 /**
  * CLASS NAME: q_elt
  *
@@ -54,6 +64,15 @@ public:
 	}
 };
 
+/**
+ * Membership states of an entry
+ */
+enum MemberState {
+	MEMBER_ALIVE,
+	// Timed out somewhere, kept until TREMOVE unless refuted by a newer incarnation
+	MEMBER_SUSPECT
+};
+
 /**
  * CLASS NAME: MemberListEntry
  *
@@ -65,9 +84,12 @@ public:
 	short port;
 	long heartbeat;
 	long timestamp;
+	// Bumped only by the member itself to refute a suspicion
+	long incarnation;
+	MemberState state;
 	MemberListEntry(int id, short port, long heartbeat, long timestamp);
 	MemberListEntry(int id, short port);
-	MemberListEntry(): id(0), port(0), heartbeat(0), timestamp(0) {}
+	MemberListEntry(): id(0), port(0), heartbeat(0), timestamp(0), incarnation(0), state(MEMBER_ALIVE) {}
 	MemberListEntry(const MemberListEntry &anotherMLE);
 	MemberListEntry& operator =(const MemberListEntry &anotherMLE);
 	int getid();
@@ -78,6 +100,325 @@ public:
 	void setport(short port);
 	void setheartbeat(long hearbeat);
 	void settimestamp(long timestamp);
+	long getincarnation();
+	MemberState getstate();
+	void setincarnation(long incarnation);
+	void setstate(MemberState state);
+};
+
+class MemberTable;
+
+/**
+ * CLASS NAME: MemberView
+ *
+ * DESCRIPTION: One row of a MemberTable, with the accessors of MemberListEntry.
+ * 				Only valid until the table gains or loses a row.
+ */
+class MemberView {
+private:
+	MemberTable *table;
+	unsigned int row;
+public:
+	MemberView(MemberTable *table, unsigned int row): table(table), row(row) {}
+	unsigned int position() {
+		return row;
+	}
+	int getid();
+	short getport();
+	long getheartbeat();
+	long gettimestamp();
+	long getincarnation();
+	MemberState getstate();
+	void setheartbeat(long heartbeat);
+	void settimestamp(long timestamp);
+	void setincarnation(long incarnation);
+	void setstate(MemberState state);
+	// copy of the row
+	MemberListEntry entry();
+};
+
+/**
+ * CLASS NAME: SharedColumn
+ *
+ * DESCRIPTION: Column of a MemberTable kept as immutable chunks of MEMBER_CHUNK_ROWS rows.
+ * 				Frozen chunks are interned, so tables holding the same rows share them
+ * 				across simulated nodes. The first write after a freeze thaws the column
+ * 				into a private vector until the next freeze.
+ * 				The pool is shared by every column of the type, interning takes its lock.
+ */
+template <typename T>
+class SharedColumn {
+private:
+	typedef shared_ptr<const vector<T> > Chunk;
+	typedef map<unsigned long, vector<weak_ptr<const vector<T> > > > Pool;
+	// chunks of the last freeze
+	vector<Chunk> chunks;
+	// private copy of every row while thawed
+	vector<T> rows;
+	bool thawed;
+	unsigned int count;
+
+	static Pool &pool() {
+		static Pool instance;
+		return instance;
+	}
+	static mutex &poolLock() {
+		static mutex instance;
+		return instance;
+	}
+
+	// returns the pooled chunk equal to the given rows, pooling them if there is none
+	static Chunk intern(const vector<T> &chunk) {
+		// FNV-1a over the raw bytes, T is always a plain integer
+		unsigned long hash = 14695981039346656037UL;
+		const unsigned char *bytes = (const unsigned char *)chunk.data();
+		for ( size_t i = 0; i < chunk.size() * sizeof(T); i++ ) {
+			hash = (hash ^ bytes[i]) * 1099511628211UL;
+		}
+		lock_guard<mutex> guard(poolLock());
+		vector<weak_ptr<const vector<T> > > &bucket = pool()[hash];
+		for ( unsigned int i = 0; i < bucket.size(); ) {
+			Chunk pooled = bucket[i].lock();
+			if ( !pooled ) {
+				bucket[i] = bucket.back();
+				bucket.pop_back();
+				continue;
+			}
+			if ( *pooled == chunk ) {
+				return pooled;
+			}
+			i++;
+		}
+		Chunk made = make_shared<const vector<T> >(chunk);
+		bucket.push_back(made);
+		sweep();
+		return made;
+	}
+
+	// drops the chunks no column holds any more once the pool has twice the live entries,
+	// called with the pool lock held
+	static void sweep() {
+		static unsigned int live = 1;
+		Pool &instance = pool();
+		if ( instance.size() <= 2 * live ) {
+			return;
+		}
+		for ( typename Pool::iterator it = instance.begin(); it != instance.end(); ) {
+			unsigned int i = 0;
+			while ( i < it->second.size() ) {
+				if ( it->second[i].expired() ) {
+					it->second[i] = it->second.back();
+					it->second.pop_back();
+				}
+				else {
+					i++;
+				}
+			}
+			if ( it->second.empty() ) {
+				instance.erase(it++);
+			}
+			else {
+				++it;
+			}
+		}
+		live = instance.size();
+	}
+
+public:
+	SharedColumn(): thawed(false), count(0) {}
+
+	unsigned int size() const {
+		return thawed ? rows.size() : count;
+	}
+	T get(unsigned int row) const {
+		if ( thawed ) {
+			return rows[row];
+		}
+		return (*chunks[row / MEMBER_CHUNK_ROWS])[row % MEMBER_CHUNK_ROWS];
+	}
+	void set(unsigned int row, T value) {
+		// Writing what is already there keeps the column frozen
+		if ( get(row) != value ) {
+			edit()[row] = value;
+		}
+	}
+	// thaws the column and returns its rows for writing
+	vector<T> &edit() {
+		if ( !thawed ) {
+			rows.clear();
+			rows.reserve(count);
+			for ( unsigned int c = 0; c < chunks.size(); c++ ) {
+				rows.insert(rows.end(), chunks[c]->begin(), chunks[c]->end());
+			}
+			thawed = true;
+		}
+		return rows;
+	}
+	void freeze() {
+		if ( !thawed ) {
+			return;
+		}
+		vector<Chunk> frozen;
+		for ( unsigned int start = 0; start < rows.size(); start += MEMBER_CHUNK_ROWS ) {
+			unsigned int end = min((unsigned int)rows.size(), start + MEMBER_CHUNK_ROWS);
+			vector<T> chunk(rows.begin() + start, rows.begin() + end);
+			unsigned int c = frozen.size();
+			// Untouched chunks are kept as they are, only the changed ones go to the pool
+			if ( c < chunks.size() && *chunks[c] == chunk ) {
+				frozen.push_back(chunks[c]);
+			}
+			else {
+				frozen.push_back(intern(chunk));
+			}
+		}
+		chunks.swap(frozen);
+		count = rows.size();
+		vector<T>().swap(rows);
+		thawed = false;
+	}
+	// appends the chunks of the column, which tell equal columns apart in O(chunks); false while thawed
+	bool shareChunks(vector<shared_ptr<const void> > &out) const {
+		if ( thawed ) {
+			return false;
+		}
+		out.insert(out.end(), chunks.begin(), chunks.end());
+		return true;
+	}
+	// bytes only this column holds, and its share of the chunks it holds with others
+	void memoryUsage(size_t &privateBytes, double &sharedBytes) const {
+		privateBytes += rows.capacity() * sizeof(T) + chunks.capacity() * sizeof(Chunk);
+		for ( unsigned int c = 0; c < chunks.size(); c++ ) {
+			size_t bytes = chunks[c]->capacity() * sizeof(T);
+			if ( chunks[c].use_count() == 1 ) {
+				privateBytes += bytes;
+			}
+			else {
+				sharedBytes += (double)bytes / chunks[c].use_count();
+			}
+		}
+	}
+};
+
+/**
+ * CLASS NAME: MemberTable
+ *
+ * DESCRIPTION: Membership table stored one column per field, rows sorted by id.
+ * 				The columns read by the failure detector every period, heartbeats and
+ * 				last update ticks, are private and contiguous so that the timeout scan
+ * 				compares several rows at once. The other columns are SharedColumns:
+ * 				members with the same view of the group share them.
+ */
+class MemberTable {
+public:
+	SharedColumn<int> ids;
+	SharedColumn<short> ports;
+	SharedColumn<long> incarnations;
+	SharedColumn<unsigned char> states;
+	vector<long> heartbeats;
+	// local tick of the last update, ticks stay far below 2^31
+	vector<int> timestamps;
+
+	unsigned int size() {
+		return heartbeats.size();
+	}
+	bool empty() {
+		return heartbeats.empty();
+	}
+	MemberView operator [](unsigned int row) {
+		return MemberView(this, row);
+	}
+	// adds a row in id order and returns its position
+	unsigned int insert(const MemberListEntry &entry);
+	// position of the row of the given id, -1 if there is none
+	int find(int id);
+	// removes a row, the rows after it move up by one
+	void erase(unsigned int row);
+	void clear();
+	// shares the chunks of the shared columns written since the last freeze
+	void freeze();
+	void memoryUsage(size_t &privateBytes, double &sharedBytes);
+	// copy of the whole table, for the wire
+	vector<MemberListEntry> entries();
+	// rows last updated before the given tick
+	void updatedBefore(int tick, vector<unsigned int> &rows);
+};
+
+/**
+ * Types of membership changes
+ */
+enum MembershipEventType {
+	MEMBER_JOINED,
+	MEMBER_LEFT
+};
+
+/**
+ * CLASS NAME: MembershipEvent
+ *
+ * DESCRIPTION: A join or leave seen by the membership protocol, stamped with
+ * 				the membership version it produced
+ */
+class MembershipEvent {
+public:
+	MembershipEventType type;
+	int id;
+	short port;
+	long version;
+	MembershipEvent(MembershipEventType type, int id, short port, long version): type(type), id(id), port(port), version(version) {}
+};
+
+/**
+ * CLASS NAME: MembershipSnapshot
+ *
+ * DESCRIPTION: Immutable copy of the membership, published by MP1 for the KV store.
+ * 				The id and port columns share their chunks with the table they were
+ * 				taken from, so a snapshot costs a pointer per chunk.
+ */
+class MembershipSnapshot {
+public:
+	// membership version of this snapshot
+	long version;
+	// version of the snapshot before this one, -1 if the events in between were dropped
+	long previousVersion;
+	// joins and leaves from previousVersion to version, oldest first
+	vector<MembershipEvent> events;
+	SharedColumn<int> ids;
+	SharedColumn<short> ports;
+	MembershipSnapshot(): version(0), previousVersion(-1) {}
+};
+
+/**
+ * CLASS NAME: SnapshotPublisher
+ *
+ * DESCRIPTION: Read-copy-update publication of MembershipSnapshots by a single writer.
+ * 				The writer swaps the new snapshot in with one atomic exchange. Readers
+ * 				take no lock: they announce the epoch they entered in, and a replaced
+ * 				snapshot is freed once no reader is left in an epoch it was current in.
+ */
+class SnapshotPublisher {
+private:
+	atomic<const MembershipSnapshot *> current;
+	atomic<unsigned long> epoch;
+	// epoch each reader entered in, 0 while it holds no snapshot
+	atomic<unsigned long> readers[MAX_SNAPSHOT_READERS];
+	// whether each reader slot is handed out
+	atomic<bool> registered[MAX_SNAPSHOT_READERS];
+	// replaced snapshots with the last epoch they were current in, writer only
+	vector<pair<unsigned long, const MembershipSnapshot *> > retired;
+
+	void reclaim();
+
+public:
+	SnapshotPublisher();
+	~SnapshotPublisher();
+	// writer: makes the snapshot current and takes ownership of it
+	void publish(const MembershipSnapshot *snapshot);
+	// reader: slot to pass to acquire and release, -1 if all are taken
+	int registerReader();
+	// reader: give the slot back once done reading
+	void unregisterReader(int reader);
+	// reader: current snapshot, NULL if none, valid until release
+	const MembershipSnapshot *acquire(int reader);
+	void release(int reader);
 };
 
 /**
@@ -100,14 +441,20 @@ public:
 	int nnb;
 	// the node's own heartbeat
 	long heartbeat;
+	// the node's own incarnation number
+	long incarnation;
 	// counter for next ping
 	int pingCounter;
 	// counter for ping timeout
 	int timeOutCounter;
 	// Membership table
-	vector<MemberListEntry> memberList;
+	MemberTable memberList;
 	// My position in the membership table
-	vector<MemberListEntry>::iterator myPos;
+	unsigned int myPos;
+	// Bumped on every join or leave in memberList
+	long membershipVersion;
+	// Membership as last published by MP1, the KV store reads it from here
+	SnapshotPublisher membership;
 	// Queue for failure detection messages
 	queue<q_elt> mp1q;
 	// Queue for KVstore messages
@@ -115,7 +462,7 @@ public:
 	/**
 	 * Constructor
 	 */
-	Member(): inited(false), inGroup(false), bFailed(false), nnb(0), heartbeat(0), pingCounter(0), timeOutCounter(0) {}
+	Member(): inited(false), inGroup(false), bFailed(false), nnb(0), heartbeat(0), incarnation(0), pingCounter(0), timeOutCounter(0), myPos(0), membershipVersion(0) {}
 	// copy constructor
 	Member(const Member &anotherMember);
 	// Assignment operator overloading
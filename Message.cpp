@@ -8,12 +8,13 @@
 /**
  * Constructor
  */
-// transID::fromAddr::CREATE::key::value::ReplicaType
-// transID::fromAddr::READ::key
-// transID::fromAddr::UPDATE::key::value::ReplicaType
-// transID::fromAddr::DELETE::key
-// transID::fromAddr::REPLY::sucess
-// transID::fromAddr::READREPLY::value
+// transID::fromAddr::CREATE::epoch::key::value::ReplicaType
+// transID::fromAddr::READ::epoch::key
+// transID::fromAddr::UPDATE::epoch::key::value::ReplicaType
+// transID::fromAddr::DELETE::epoch::key
+// transID::fromAddr::REPLY::epoch::sucess
+// transID::fromAddr::READREPLY::epoch::value
+// transID::fromAddr::REDIRECT::epoch::key::replica,replica,...
 Message::Message(string message){
 	this->delimiter = "::";
 	vector<string> tuple;
@@ -31,26 +32,31 @@ Message::Message(string message){
 	Address addr(tuple.at(1));
 	fromAddr = addr;
 	type = static_cast<MessageType>(stoi(tuple.at(2)));
+	epoch = stoi(tuple.at(3));
 	switch(type){
 		case CREATE:
 		case UPDATE:
-			key = tuple.at(3);
-			value = tuple.at(4);
-			if (tuple.size() > 5)
-				replica = static_cast<ReplicaType>(stoi(tuple.at(5)));
+			key = tuple.at(4);
+			value = tuple.at(5);
+			if (tuple.size() > 6)
+				replica = static_cast<ReplicaType>(stoi(tuple.at(6)));
 			break;
 		case READ:
 		case DELETE:
-			key = tuple.at(3);
+			key = tuple.at(4);
 			break;
 		case REPLY:
-			if (tuple.at(3) == "1")
+			if (tuple.at(4) == "1")
 				success = true;
 			else
 				success = false;
 			break;
 		case READREPLY:
-			value = tuple.at(3);
+			value = tuple.at(4);
+			break;
+		case REDIRECT:
+			key = tuple.at(4);
+			value = tuple.at(5);
 			break;
 	}
 }
@@ -61,6 +67,7 @@ Message::Message(string message){
 // construct a create or update message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value, ReplicaType _replica){
 	this->delimiter = "::";
+	epoch = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -79,6 +86,7 @@ Message::Message(const Message& anotherMessage) {
 	this->replica = anotherMessage.replica;
 	this->success = anotherMessage.success;
 	this->transID = anotherMessage.transID;
+	this->epoch = anotherMessage.epoch;
 	this->type = anotherMessage.type;
 	this->value = anotherMessage.value;
 }
@@ -88,6 +96,7 @@ Message::Message(const Message& anotherMessage) {
  */
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value){
 	this->delimiter = "::";
+	epoch = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -101,6 +110,7 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key
 // construct a read or delete message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key){
 	this->delimiter = "::";
+	epoch = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -113,6 +123,7 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key
 // construct reply message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, bool _success){
 	this->delimiter = "::";
+	epoch = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -125,19 +136,56 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, bool _succe
 // construct read reply message
 Message::Message(int _transID, Address _fromAddr, string _value){
 	this->delimiter = "::";
+	epoch = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = READREPLY;
 	value = _value;
 }
 
+/**
+ * Constructor
+ */
+// construct redirect message
+Message::Message(int _transID, Address _fromAddr, string _key, vector<Node> &replicas){
+	this->delimiter = "::";
+	epoch = 0;
+	transID = _transID;
+	fromAddr = _fromAddr;
+	type = REDIRECT;
+	key = _key;
+	for ( unsigned int i = 0; i < replicas.size(); i++ ) {
+		value += (i ? "," : "") + replicas[i].getAddress()->getAddress();
+	}
+}
+
+/**
+ * FUNCTION NAME: redirectReplicas
+ *
+ * DESCRIPTION: The replicas listed in a redirect message, in replica order
+ */
+vector<Address> Message::redirectReplicas() {
+	vector<Address> replicas;
+	size_t start = 0;
+	while ( start < value.size() ) {
+		size_t end = value.find(",", start);
+		if ( end == string::npos ) {
+			end = value.size();
+		}
+		replicas.push_back(Address(value.substr(start, end - start)));
+		start = end + 1;
+	}
+	return replicas;
+}
+
 /**
  * FUNCTION NAME: toString
  *
  * DESCRIPTION: Serialized Message in string format
  */
 string Message::toString(){
-	string message = to_string(transID) + delimiter + fromAddr.getAddress() + delimiter + to_string(type) + delimiter;
+	string message = to_string(transID) + delimiter + fromAddr.getAddress() + delimiter + to_string(type) + delimiter
+			+ to_string(epoch) + delimiter;
 	switch(type){
 		case CREATE:
 		case UPDATE:
@@ -156,6 +204,9 @@ string Message::toString(){
 		case READREPLY:
 			message += value;
 			break;
+		case REDIRECT:
+			message += key + delimiter + value;
+			break;
 	}
 	return message;
 }
@@ -170,6 +221,7 @@ Message& Message::operator =(const Message& anotherMessage) {
 	this->replica = anotherMessage.replica;
 	this->success = anotherMessage.success;
 	this->transID = anotherMessage.transID;
+	this->epoch = anotherMessage.epoch;
 	this->type = anotherMessage.type;
 	this->value = anotherMessage.value;
 	return *this;
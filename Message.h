@@ -8,6 +8,7 @@
 
 #include "stdincludes.h"
 #include "Member.h"
+#include "Node.h"
 #include "common.h"
 
 /**
@@ -24,6 +25,8 @@ public:
 	Address fromAddr;
 	int transID;
 	bool success; // success or not 
+	// ring epoch of the sender: the hash of the members of its ring
+	int epoch;
 	// delimiter
 	string delimiter;
 	// construct a message from a string
@@ -38,6 +41,10 @@ public:
 	Message(int _transID, Address _fromAddr, MessageType _type, bool _success);
 	// construct read reply message
 	Message(int _transID, Address _fromAddr, string _value);
+	// construct redirect message, replicas are the replicas of the key in the ring of the sender
+	Message(int _transID, Address _fromAddr, string _key, vector<Node> &replicas);
+	// the replicas a redirect message carries
+	vector<Address> redirectReplicas();
 	Message& operator = (const Message& anotherMessage);
 	// serialize to a string
 	string toString();
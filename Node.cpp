@@ -7,54 +7,81 @@
 #include "Node.h"
 
 /**
- * constructor
- */
-Node::Node() {}
-
-/**
- * constructor
+ * FUNCTION NAME: stableHash
+ *
+ * DESCRIPTION: FNV-1a over the bytes, finished with the MurmurHash3 mixer so that
+ * 				inputs differing in a single byte land far apart on the ring
  */
-Node::Node(Address address) {
-	this->nodeAddress = address;
-	computeHashCode();
+size_t stableHash(const void *data, size_t size) {
+	const unsigned char *bytes = (const unsigned char *)data;
+	unsigned long hash = 14695981039346656037UL;
+	for ( size_t i = 0; i < size; i++ ) {
+		hash ^= bytes[i];
+		hash *= 1099511628211UL;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdUL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53UL;
+	hash ^= hash >> 33;
+	return hash;
 }
 
 /**
- * Destructor
+ * FUNCTION NAME: addressKey
+ *
+ * DESCRIPTION: The six bytes of an address as the low 48 bits of an integer, as a ring
+ * 				entry packs them, so that nodes and ring entries order addresses alike
  */
-Node::~Node() {}
+unsigned long addressKey(const Address &address) {
+	unsigned long key = 0;
+	memcpy(&key, address.addr, sizeof(address.addr));
+	return key;
+}
 
 /**
- * FUNCTION NAME: computeHashCode
- *
- * DESCRIPTION: This function computes the hash code of the node address
+ * constructor
  */
-void Node::computeHashCode() {
-	nodeHashCode = hashFunc(nodeAddress.addr)%RING_SIZE;
-}
+Node::Node(): nodeHashCode(0), vnode(0) {}
 
 /**
- * copy constructor
+ * constructor
  */
-Node::Node(const Node& another) {
-	this->nodeAddress = another.nodeAddress;
-	this->nodeHashCode = another.nodeHashCode;
+Node::Node(Address address, int vnode) {
+	this->nodeAddress = address;
+	this->vnode = vnode;
+	computeHashCode();
 }
 
 /**
- * Assignment operator overloading
+ * FUNCTION NAME: computeHashCode
+ *
+ * DESCRIPTION: This function computes the hash code of the node address: the six
+ * 				bytes of the address followed by the position number. The address is
+ * 				hashed as bytes, not as a C string that ends at the first zero byte.
  */
-Node& Node::operator=(const Node& another) {
-	this->nodeAddress = another.nodeAddress;
-	this->nodeHashCode = another.nodeHashCode;
-	return *this;
+void Node::computeHashCode() {
+	unsigned char key[sizeof(nodeAddress.addr) + sizeof(vnode)];
+	memcpy(key, nodeAddress.addr, sizeof(nodeAddress.addr));
+	memcpy(key + sizeof(nodeAddress.addr), &vnode, sizeof(vnode));
+	nodeHashCode = stableHash(key, sizeof(key));
 }
 
 /**
  * operator overloading
+ *
+ * Ties on the hash code are broken by address, then by position number, so that every
+ * node orders the ring the same way, and the same way as RingEntry does
  */
 bool Node::operator < (const Node& another) const {
-	return this->nodeHashCode < another.nodeHashCode;
+	if ( this->nodeHashCode != another.nodeHashCode ) {
+		return this->nodeHashCode < another.nodeHashCode;
+	}
+	unsigned long mine = addressKey(this->nodeAddress), theirs = addressKey(another.nodeAddress);
+	if ( mine != theirs ) {
+		return mine < theirs;
+	}
+	return this->vnode < another.vnode;
 }
 
 /**
@@ -10,22 +10,25 @@
 #include "stdincludes.h"
 #include "Member.h"
 
+// 64-bit hash of a byte string that is the same on every platform and every run
+size_t stableHash(const void *data, size_t size);
+// the six bytes of an address as one integer, in the order ring ties are broken by
+unsigned long addressKey(const Address &address);
+
 class Node {
 public:
 	Address nodeAddress;
 	size_t nodeHashCode;
-	std::hash<string> hashFunc;
+	// which of the ring positions of the node this is, 0 for the first one
+	int vnode;
 	Node();
-	Node(Address address);
-	Node(const Node& another);
-	Node& operator=(const Node& another);
+	Node(Address address, int vnode = 0);
 	bool operator < (const Node& another) const;
 	void computeHashCode();
 	size_t getHashCode();
 	Address * getAddress();
 	void setHashCode(size_t hashCode);
 	void setAddress(Address address);
-	virtual ~Node();
 };
 
 #endif /* NODE_H_ */
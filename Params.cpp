@@ -11,6 +11,24 @@
  */
 Params::Params(): PORTNUM(8001) {}
 
+/**
+ * FUNCTION NAME: requestMode
+ *
+ * DESCRIPTION: The requestMODE of a READ_MODE or WRITE_MODE value, QUORUM_MODE if unknown
+ */
+static int requestMode(const char *mode) {
+	if ( 0 == strcmp(mode, "ONE") ) {
+		return ONE_MODE;
+	}
+	if ( 0 == strcmp(mode, "ALL") ) {
+		return ALL_MODE;
+	}
+	if ( 0 == strcmp(mode, "LOCAL_QUORUM") ) {
+		return LOCAL_QUORUM_MODE;
+	}
+	return QUORUM_MODE;
+}
+
 /**
  * FUNCTION NAME: setparams
  *
@@ -18,14 +36,86 @@ Params::Params(): PORTNUM(8001) {}
  */
 void Params::setparams(char *config_file) {
 	//trace.funcEntry("Params::setparams");
-	char CRUD[10];
+	char CRUD[10] = "NONE";
+	char mode[10] = "FLAT";
+	char detector[10] = "TIMEOUT";
+	char placement[10] = "RING";
+	char readMode[16] = "QUORUM";
+	char writeMode[16] = "QUORUM";
+	char line[256];
+	char label[32], otherLabel[32];
+	char *list;
+	int id, used, latency;
+	double weight;
+	map<int, string> labels;
+	map<int, double> weights;
+	vector<pair<pair<string, string>, int> > links;
 	FILE *fp = fopen(config_file,"r");
 
-	fscanf(fp,"MAX_NNB: %d", &MAX_NNB);
-	fscanf(fp,"\nSINGLE_FAILURE: %d", &SINGLE_FAILURE);
-	fscanf(fp,"\nDROP_MSG: %d", &DROP_MSG);
-	fscanf(fp,"\nMSG_DROP_PROB: %lf", &MSG_DROP_PROB);
-	fscanf(fp,"\nCRUD_TEST: %s", CRUD);
+	// Optional keys, configurations may omit any of them
+	SINGLE_FAILURE = 0;
+	DROP_MSG = 0;
+	MSG_DROP_PROB = 0;
+	ZONES = 1;
+	ZONE_RELAYS = 1;
+	ZONE_LATENCY = 0;
+	PHI_THRESHOLD = 8;
+	INTRODUCERS.clear();
+	ANTI_ENTROPY = 0;
+	LEAVES = 3;
+	GRACEFUL_LEAVE = 1;
+	VNODES = 1;
+	REPLICATION = 3;
+	READ_QUORUM = 0;
+	WRITE_QUORUM = 0;
+	LOAD_REPORT = 0;
+	this->CRUDTEST = MEMBERSHIP_TEST;
+
+	// One "KEY: value" per line, in any order
+	while ( fgets(line, sizeof(line), fp) != NULL ) {
+		sscanf(line, "MAX_NNB: %d", &MAX_NNB);
+		sscanf(line, "SINGLE_FAILURE: %d", &SINGLE_FAILURE);
+		sscanf(line, "DROP_MSG: %d", &DROP_MSG);
+		sscanf(line, "MSG_DROP_PROB: %lf", &MSG_DROP_PROB);
+		sscanf(line, "CRUD_TEST: %9s", CRUD);
+		sscanf(line, "GOSSIP_MODE: %9s", mode);
+		sscanf(line, "ZONES: %d", &ZONES);
+		sscanf(line, "ZONE_RELAYS: %d", &ZONE_RELAYS);
+		sscanf(line, "FAILURE_DETECTOR: %9s", detector);
+		sscanf(line, "PHI_THRESHOLD: %lf", &PHI_THRESHOLD);
+		sscanf(line, "ANTI_ENTROPY: %d", &ANTI_ENTROPY);
+		sscanf(line, "LEAVES: %d", &LEAVES);
+		sscanf(line, "GRACEFUL_LEAVE: %d", &GRACEFUL_LEAVE);
+		sscanf(line, "VNODES: %d", &VNODES);
+		sscanf(line, "REPLICATION: %d", &REPLICATION);
+		sscanf(line, "READ_QUORUM: %d", &READ_QUORUM);
+		sscanf(line, "WRITE_QUORUM: %d", &WRITE_QUORUM);
+		sscanf(line, "PLACEMENT: %9s", placement);
+		sscanf(line, "LOAD_REPORT: %d", &LOAD_REPORT);
+		sscanf(line, "ZONE_LATENCY: %d", &ZONE_LATENCY);
+		sscanf(line, "READ_MODE: %15s", readMode);
+		sscanf(line, "WRITE_MODE: %15s", writeMode);
+		if ( sscanf(line, "ZONE_LINK: %31s %31s %d", label, otherLabel, &latency) == 3 ) {
+			links.push_back(make_pair(make_pair(string(label), string(otherLabel)), latency));
+		}
+		if ( sscanf(line, "NODE_WEIGHT: %d %lf", &id, &weight) == 2 ) {
+			weights[id] = weight;
+		}
+		if ( sscanf(line, "NODE_ZONE: %d %31s", &id, label) == 2 ) {
+			labels[id] = label;
+		}
+		if ( 0 == strncmp(line, "INTRODUCERS:", 12) ) {
+			// Space separated list of node ids
+			list = line + 12;
+			while ( sscanf(list, "%d%n", &id, &used) == 1 ) {
+				INTRODUCERS.push_back(id);
+				list += used;
+			}
+		}
+	}
+	if ( INTRODUCERS.empty() ) {
+		INTRODUCERS.push_back(1);
+	}
 
 	if ( 0 == strcmp(CRUD, "CREATE") ) {
 		this->CRUDTEST = CREATE_TEST;
@@ -39,6 +129,23 @@ void Params::setparams(char *config_file) {
 	else if ( 0 == strcmp(CRUD, "DELETE") ) {
 		this->CRUDTEST = DELETE_TEST;
 	}
+	else if ( 0 == strcmp(CRUD, "LEAVE") ) {
+		this->CRUDTEST = LEAVE_TEST;
+	}
+
+	GOSSIP_MODE = ( 0 == strcmp(mode, "ZONE") ) ? ZONE_GOSSIP : FLAT_GOSSIP;
+	FAILURE_DETECTOR = ( 0 == strcmp(detector, "PHI") ) ? PHI_DETECTOR : TIMEOUT_DETECTOR;
+	if ( 0 == strcmp(placement, "HRW") ) {
+		PLACEMENT = RENDEZVOUS_PLACEMENT;
+	}
+	else if ( 0 == strcmp(placement, "JUMP") ) {
+		PLACEMENT = JUMP_PLACEMENT;
+	}
+	else {
+		PLACEMENT = RING_PLACEMENT;
+	}
+	READ_MODE = requestMode(readMode);
+	WRITE_MODE = requestMode(writeMode);
 
 	//printf("Parameters of the test case: %d %d %d %lf\n", MAX_NNB, SINGLE_FAILURE, DROP_MSG, MSG_DROP_PROB);
 
@@ -51,6 +158,62 @@ void Params::setparams(char *config_file) {
 	for ( unsigned int i = 0; i < EN_GPSZ; i++ ) {
 		allNodesJoined += i;
 	}
+
+	// Split the nodes evenly by id, then apply the NODE_ZONE labels
+	if ( ZONES < 1 ) {
+		ZONES = 1;
+	}
+	zoneNames.clear();
+	for ( int i = 0; i < ZONES; i++ ) {
+		zoneNames.push_back("zone" + to_string(i));
+	}
+	nodeZone.assign(EN_GPSZ + 1, 0);
+	for ( int i = 1; i <= EN_GPSZ; i++ ) {
+		nodeZone[i] = (i - 1) * ZONES / EN_GPSZ;
+	}
+	for ( map<int, string>::iterator it = labels.begin(); it != labels.end(); ++it ) {
+		if ( it->first < 1 || it->first > EN_GPSZ ) {
+			continue;
+		}
+		vector<string>::iterator name = find(zoneNames.begin(), zoneNames.end(), it->second);
+		nodeZone[it->first] = name - zoneNames.begin();
+		if ( name == zoneNames.end() ) {
+			zoneNames.push_back(it->second);
+		}
+	}
+	ZONES = zoneNames.size();
+
+	// ZONE_LATENCY between any two zones, then the ZONE_LINK latencies of pairs of named zones
+	zoneLatency.assign(ZONES, vector<int>(ZONES, max(0, ZONE_LATENCY)));
+	for ( int z = 0; z < ZONES; z++ ) {
+		zoneLatency[z][z] = 0;
+	}
+	for ( unsigned int l = 0; l < links.size(); l++ ) {
+		int from = find(zoneNames.begin(), zoneNames.end(), links[l].first.first) - zoneNames.begin();
+		int to = find(zoneNames.begin(), zoneNames.end(), links[l].first.second) - zoneNames.begin();
+		if ( from < ZONES && to < ZONES ) {
+			zoneLatency[from][to] = zoneLatency[to][from] = max(0, links[l].second);
+		}
+	}
+
+	if ( VNODES < 1 ) {
+		VNODES = 1;
+	}
+	// Quorums default to a majority of the replicas
+	REPLICATION = max(1, REPLICATION);
+	if ( READ_QUORUM < 1 || READ_QUORUM > REPLICATION ) {
+		READ_QUORUM = REPLICATION / 2 + 1;
+	}
+	if ( WRITE_QUORUM < 1 || WRITE_QUORUM > REPLICATION ) {
+		WRITE_QUORUM = REPLICATION / 2 + 1;
+	}
+	nodeWeight.assign(EN_GPSZ + 1, 1);
+	for ( map<int, double>::iterator it = weights.begin(); it != weights.end(); ++it ) {
+		if ( it->first >= 1 && it->first <= EN_GPSZ && it->second > 0 ) {
+			nodeWeight[it->first] = it->second;
+		}
+	}
+
 	fclose(fp);
 	//trace.funcExit("Params::setparams", SUCCESS);
 	return;
@@ -65,3 +228,38 @@ void Params::setparams(char *config_file) {
 int Params::getcurrtime(){
     return globaltime;
 }
+
+/**
+ * FUNCTION NAME: getZone
+ *
+ * DESCRIPTION: Return the emulated zone of the node with the given id
+ */
+int Params::getZone(int id) {
+	if ( id < 1 || id >= (int)nodeZone.size() ) {
+		return 0;
+	}
+	return nodeZone[id];
+}
+
+/**
+ * FUNCTION NAME: getLatency
+ *
+ * DESCRIPTION: Return the periods a message takes from the node with id from to the node with id to
+ */
+int Params::getLatency(int from, int to) {
+	return zoneLatency.empty() ? 0 : zoneLatency[getZone(from)][getZone(to)];
+}
+
+/**
+ * FUNCTION NAME: getVnodes
+ *
+ * DESCRIPTION: Return the number of ring positions of the node with the given id,
+ * 				VNODES scaled by its weight and at least one
+ */
+int Params::getVnodes(int id) {
+	// Ring entries keep the position number of a node in 16 bits
+	if ( id < 1 || id >= (int)nodeWeight.size() ) {
+		return min(VNODES, 1 << 16);
+	}
+	return min(max(1, (int)(VNODES * nodeWeight[id] + 0.5)), 1 << 16);
+}
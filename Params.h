@@ -11,7 +11,18 @@
 #include "Params.h"
 #include "Member.h"
 
-enum testTYPE { CREATE_TEST, READ_TEST, UPDATE_TEST, DELETE_TEST };
+// MEMBERSHIP_TEST runs only the membership protocol failure scenarios of Application::fail
+// LEAVE_TEST takes LEAVES nodes out of the KV store one after the other
+enum testTYPE { CREATE_TEST, READ_TEST, UPDATE_TEST, DELETE_TEST, MEMBERSHIP_TEST, LEAVE_TEST };
+// FLAT_GOSSIP picks peers uniformly, ZONE_GOSSIP stays within the zone except for relays
+enum gossipTYPE { FLAT_GOSSIP, ZONE_GOSSIP };
+// TIMEOUT_DETECTOR suspects after TFAIL periods, PHI_DETECTOR once phi crosses PHI_THRESHOLD
+enum detectorTYPE { TIMEOUT_DETECTOR, PHI_DETECTOR };
+// where the replicas of a key go: consistent hashing ring, rendezvous (HRW) or jump hash
+enum placementTYPE { RING_PLACEMENT, RENDEZVOUS_PLACEMENT, JUMP_PLACEMENT };
+// replicas the requests of the tests wait for: READ_QUORUM or WRITE_QUORUM, one, all of them,
+// or a majority of those in the zone of the coordinator
+enum requestMODE { QUORUM_MODE, ONE_MODE, ALL_MODE, LOCAL_QUORUM_MODE };
 
 /**
  * CLASS NAME: Params
@@ -32,9 +43,34 @@ public:
 	int allNodesJoined;
 	short PORTNUM;
 	int CRUDTEST;
+	int GOSSIP_MODE;
+	int ZONES;                  // number of emulated zones (racks), nodes are split evenly by id
+	int ZONE_RELAYS;            // members per zone that also gossip across zones
+	vector<int> nodeZone;       // zone of each node id, index 0 unused
+	vector<string> zoneNames;
+	int ZONE_LATENCY;           // periods a message takes between two zones, 0 within a zone
+	vector<vector<int> > zoneLatency; // periods a message takes from zone to zone
+	int FAILURE_DETECTOR;
+	double PHI_THRESHOLD;
+	vector<int> INTRODUCERS;    // ids of the nodes that answer JOINREQs, the first one boots the group
+	int ANTI_ENTROPY;           // periods between digest exchanges, 0 turns anti-entropy off
+	int LEAVES;                 // nodes taken out by the leave test
+	int GRACEFUL_LEAVE;         // leave test nodes hand off their keys and announce it, else they crash
+	int VNODES;                 // ring positions of a node of weight 1
+	vector<double> nodeWeight;  // capacity weight of each node id, index 0 unused
+	int REPLICATION;            // N, replicas of every key
+	int READ_QUORUM;            // R, replicas that must return the same value to a read
+	int WRITE_QUORUM;           // W, replicas that must acknowledge a create, update or delete
+	int PLACEMENT;              // replica placement strategy of the KV store
+	int LOAD_REPORT;            // periods between dumps of the KV store load, 0 dumps it only at the end
+	int READ_MODE;              // replicas the reads of the tests wait for
+	int WRITE_MODE;             // replicas the creates, updates and deletes of the tests wait for
 	Params();
 	void setparams(char *);
 	int getcurrtime();
+	int getZone(int id);
+	int getLatency(int from, int to);
+	int getVnodes(int id);
 };
 
 #endif /* _PARAMS_H_ */
@@ -0,0 +1,648 @@
+/**********************************
+ * FILE NAME: Ring.cpp
+ *
+ * DESCRIPTION: Consistent hashing ring of the KV store
+ **********************************/
+
+#include "Ring.h"
+
+/**
+ * FUNCTION NAME: packAddress
+ *
+ * DESCRIPTION: The six bytes of an address as the high 48 bits of a ring entry node
+ */
+static unsigned long packAddress(const Address &address) {
+	return addressKey(address) << RING_VNODE_BITS;
+}
+
+/**
+ * FUNCTION NAME: byAddress
+ *
+ * DESCRIPTION: Order of the physical nodes
+ */
+static bool byAddress(const RingEntry &a, const RingEntry &b) {
+	return a.address() < b.address();
+}
+
+/**
+ * FUNCTION NAME: mix64
+ *
+ * DESCRIPTION: MurmurHash3 finalizer, spreads every input bit over the output
+ */
+static unsigned long mix64(unsigned long value) {
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdUL;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53UL;
+	value ^= value >> 33;
+	return value;
+}
+
+/**
+ * FUNCTION NAME: jumpHash
+ *
+ * DESCRIPTION: Jump consistent hash (Lamping and Veach) of a key into one of buckets buckets
+ */
+static int jumpHash(unsigned long key, int buckets) {
+	long bucket = -1, next = 0;
+	while ( next < buckets ) {
+		bucket = next;
+		key = key * 2862933555777941757UL + 1;
+		next = (long)((bucket + 1) * ((double)(1L << 31) / (double)((key >> 33) + 1)));
+	}
+	return (int)bucket;
+}
+
+/**
+ * Macros
+ */
+// jumps of a key landing on the buckets of nodes not on the ring before taking the next node
+#define JUMP_ATTEMPTS 8
+
+/**
+ * Constructor
+ */
+Ring::Ring(): placement(RING_PLACEMENT), slotsStale(true), nodeZone(NULL), zoneCount(1) {}
+
+/**
+ * FUNCTION NAME: toEntry
+ *
+ * DESCRIPTION: The ring entry of a node
+ */
+RingEntry Ring::toEntry(const Node &node) {
+	RingEntry entry;
+	entry.position = node.nodeHashCode;
+	entry.node = packAddress(node.nodeAddress) | (unsigned int)node.vnode;
+	return entry;
+}
+
+/**
+ * FUNCTION NAME: toNode
+ *
+ * DESCRIPTION: The node of a ring entry, without hashing its address again
+ */
+Node Ring::toNode(const RingEntry &entry) {
+	Node node;
+	unsigned long address = entry.address();
+	memcpy(node.nodeAddress.addr, &address, sizeof(node.nodeAddress.addr));
+	node.nodeHashCode = entry.position;
+	node.vnode = entry.node & ((1UL << RING_VNODE_BITS) - 1);
+	return node;
+}
+
+/**
+ * FUNCTION NAME: assign
+ *
+ * DESCRIPTION: Replace the nodes of the ring
+ */
+void Ring::assign(const vector<Node> &positions) {
+	nodes.resize(positions.size());
+	for ( unsigned int i = 0; i < positions.size(); i++ ) {
+		nodes[i] = toEntry(positions[i]);
+	}
+	sort(nodes.begin(), nodes.end());
+	slotsStale = true;
+
+	members.clear();
+	memberVnodes.clear();
+	vector<RingEntry> physical(nodes);
+	sort(physical.begin(), physical.end(), byAddress);
+	for ( unsigned int i = 0; i < physical.size(); i++ ) {
+		if ( !members.empty() && members.back().address() == physical[i].address() ) {
+			memberVnodes.back()++;
+		}
+		else {
+			Node first(toNode(physical[i]).nodeAddress);
+			members.push_back(toEntry(first));
+			memberVnodes.push_back(1);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: insert
+ *
+ * DESCRIPTION: Add a position, keeping the ring sorted
+ */
+bool Ring::insert(const RingEntry &entry) {
+	vector<RingEntry>::iterator pos = lower_bound(nodes.begin(), nodes.end(), entry);
+	if ( pos != nodes.end() && !(entry < *pos) ) {
+		return false;
+	}
+	nodes.insert(pos, entry);
+	slotsStale = true;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: erase
+ *
+ * DESCRIPTION: Remove a position
+ */
+bool Ring::erase(const RingEntry &entry) {
+	vector<RingEntry>::iterator pos = lower_bound(nodes.begin(), nodes.end(), entry);
+	if ( pos == nodes.end() || entry < *pos ) {
+		return false;
+	}
+	nodes.erase(pos);
+	slotsStale = true;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: insertMember
+ *
+ * DESCRIPTION: Add a physical node and its vnodes positions
+ */
+void Ring::insertMember(Address &address, int vnodes) {
+	Node first(address);
+	RingEntry member = toEntry(first);
+	vector<RingEntry>::iterator it = lower_bound(members.begin(), members.end(), member, byAddress);
+	if ( it != members.end() && it->address() == member.address() ) {
+		return;
+	}
+	memberVnodes.insert(memberVnodes.begin() + (it - members.begin()), vnodes);
+	members.insert(it, member);
+	for ( int v = 0; v < vnodes; v++ ) {
+		Node node(address, v);
+		insert(toEntry(node));
+	}
+}
+
+/**
+ * FUNCTION NAME: eraseMember
+ *
+ * DESCRIPTION: Remove a physical node and its vnodes positions
+ */
+void Ring::eraseMember(Address &address, int vnodes) {
+	Node first(address);
+	RingEntry member = toEntry(first);
+	vector<RingEntry>::iterator it = lower_bound(members.begin(), members.end(), member, byAddress);
+	if ( it != members.end() && it->address() == member.address() ) {
+		memberVnodes.erase(memberVnodes.begin() + (it - members.begin()));
+		members.erase(it);
+	}
+	for ( int v = 0; v < vnodes; v++ ) {
+		Node node(address, v);
+		erase(toEntry(node));
+	}
+}
+
+/**
+ * FUNCTION NAME: rebuildSlots
+ *
+ * DESCRIPTION: Find the first node of every slot in one walk over the ring, and with jump
+ * 				placement the node of every bucket
+ */
+void Ring::rebuildSlots() const {
+	slotOwner.resize(1 << RING_SLOT_BITS);
+	unsigned int i = 0;
+	for ( unsigned int slot = 0; slot < slotOwner.size(); slot++ ) {
+		size_t start = (size_t)slot << (64 - RING_SLOT_BITS);
+		while ( i < nodes.size() && nodes[i].position < start ) {
+			i++;
+		}
+		slotOwner[slot] = i;
+	}
+
+	bucketMember.clear();
+	if ( placement == JUMP_PLACEMENT && !members.empty() ) {
+		unsigned int highest = 0;
+		for ( unsigned int i = 0; i < members.size(); i++ ) {
+			highest = max(highest, (unsigned int)members[i].address());
+		}
+		bucketMember.assign(highest + 1, -1);
+		for ( unsigned int i = 0; i < members.size(); i++ ) {
+			bucketMember[(unsigned int)members[i].address()] = i;
+		}
+	}
+	slotsStale = false;
+}
+
+/**
+ * FUNCTION NAME: ownerOf
+ *
+ * DESCRIPTION: Ring index of the node that owns a ring position. The slot table gives
+ * 				the first node of the slot of the position, with fewer nodes than
+ * 				slots the owner is at most a step or two further.
+ */
+unsigned int Ring::ownerOf(size_t pos) const {
+	if ( slotsStale ) {
+		rebuildSlots();
+	}
+	unsigned int i = slotOwner[pos >> (64 - RING_SLOT_BITS)];
+	while ( i < nodes.size() && nodes[i].position < pos ) {
+		i++;
+	}
+	return i == nodes.size() ? 0 : i;
+}
+
+/**
+ * FUNCTION NAME: replicasOf
+ *
+ * DESCRIPTION: The physical nodes holding the key hashed to a position, in replica order
+ */
+void Ring::replicasOf(size_t pos, unsigned int count, vector<Node> &out) const {
+	out.clear();
+	if ( members.empty() ) {
+		return;
+	}
+	switch ( placement ) {
+		case RENDEZVOUS_PLACEMENT:
+			rendezvousReplicas(pos, count, out);
+			break;
+		case JUMP_PLACEMENT:
+			jumpReplicas(pos, count, out);
+			break;
+		default:
+			ringReplicas(pos, count, out);
+			break;
+	}
+}
+
+/**
+ * FUNCTION NAME: ringReplicas
+ *
+ * DESCRIPTION: The owner of a ring position and the nodes that follow it, skipping
+ * 				further positions of physical nodes already picked
+ */
+void Ring::ringReplicas(size_t pos, unsigned int count, vector<Node> &out) const {
+	walkReplicas(ownerOf(pos), count, out);
+}
+
+/**
+ * FUNCTION NAME: zoneOf
+ *
+ * DESCRIPTION: Zone of the node of a ring entry, the id being the first four address bytes
+ */
+int Ring::zoneOf(const RingEntry &entry) const {
+	unsigned int id = (unsigned int)entry.address();
+	return id < nodeZone->size() ? (*nodeZone)[id] : 0;
+}
+
+/**
+ * FUNCTION NAME: walkReplicas
+ *
+ * DESCRIPTION: Append the node at ring index first and the next distinct physical nodes.
+ * 				With zone aware placement the next nodes of zones not picked yet come
+ * 				first, until every zone has a replica; a physical node is in one zone,
+ * 				so this picks distinct nodes too.
+ */
+void Ring::walkReplicas(unsigned int first, unsigned int count, vector<Node> &out) const {
+	unsigned int start = out.size();
+	if ( zoneAware() ) {
+		vector<int> zones;
+		for ( unsigned int i = 0; i < nodes.size() && out.size() - start < count && (int)zones.size() < zoneCount; i++ ) {
+			const RingEntry &entry = nodes[(first + i) % nodes.size()];
+			int zone = zoneOf(entry);
+			if ( find(zones.begin(), zones.end(), zone) == zones.end() ) {
+				zones.push_back(zone);
+				out.push_back(toNode(entry));
+			}
+		}
+	}
+	for ( unsigned int i = 0; i < nodes.size() && out.size() - start < count; i++ ) {
+		const RingEntry &entry = nodes[(first + i) % nodes.size()];
+		bool picked = false;
+		for ( unsigned int j = start; j < out.size() && !picked; j++ ) {
+			picked = packAddress(out[j].nodeAddress) >> RING_VNODE_BITS == entry.address();
+		}
+		if ( !picked ) {
+			out.push_back(toNode(entry));
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: replicasOfMany
+ *
+ * DESCRIPTION: The replicas of many keys at once. With the ring the keys are bucketed by
+ * 				their owner, found from the slot table, and the replicas of each owner
+ * 				are walked once for all its keys. The other placements look up each key.
+ */
+void Ring::replicasOfMany(const vector<size_t> &positions, unsigned int count, vector<unsigned int> &setOf, vector<Node> &replicas) const {
+	setOf.resize(positions.size());
+	replicas.clear();
+	if ( members.empty() ) {
+		return;
+	}
+	if ( placement != RING_PLACEMENT ) {
+		vector<Node> one;
+		for ( unsigned int k = 0; k < positions.size(); k++ ) {
+			replicasOf(positions[k], count, one);
+			replicas.insert(replicas.end(), one.begin(), one.end());
+			setOf[k] = k;
+		}
+		return;
+	}
+
+	unsigned int none = positions.size();
+	vector<unsigned int> setOfOwner(nodes.size(), none);
+	unsigned int sets = 0;
+	for ( unsigned int k = 0; k < positions.size(); k++ ) {
+		unsigned int owner = ownerOf(positions[k]);
+		if ( setOfOwner[owner] == none ) {
+			setOfOwner[owner] = sets++;
+			walkReplicas(owner, count, replicas);
+		}
+		setOf[k] = setOfOwner[owner];
+	}
+}
+
+/**
+ * FUNCTION NAME: rendezvousReplicas
+ *
+ * DESCRIPTION: The count physical nodes with the highest scores for the key. A node of
+ * 				weight w scores -w / ln(u) for a uniform u drawn from the key and node
+ * 				hashes, so it wins a share of the keys proportional to w.
+ */
+void Ring::rendezvousReplicas(size_t pos, unsigned int count, vector<Node> &out) const {
+	vector<pair<double, unsigned int> > scores(members.size());
+	for ( unsigned int i = 0; i < members.size(); i++ ) {
+		unsigned long draw = mix64(pos ^ members[i].position);
+		double uniform = ((draw >> 11) + 0.5) / (double)(1UL << 53);
+		scores[i] = make_pair(-memberVnodes[i] / log(uniform), i);
+	}
+	unsigned int picked = min(count, (unsigned int)members.size());
+	partial_sort(scores.begin(), scores.begin() + picked, scores.end(), greater<pair<double, unsigned int> >());
+	for ( unsigned int i = 0; i < picked; i++ ) {
+		out.push_back(toNode(members[scores[i].second]));
+	}
+}
+
+/**
+ * FUNCTION NAME: jumpReplicas
+ *
+ * DESCRIPTION: The bucket the key jumps to and the buckets after it. Bucket b belongs to
+ * 				the node with id b and stays empty while that node is not on the
+ * 				ring, so a node leaving from the middle of the id range only moves its
+ * 				own keys. A key that jumps to an empty bucket jumps again with another
+ * 				key, up to JUMP_ATTEMPTS times, then takes the next node. Weights are
+ * 				not supported.
+ */
+void Ring::jumpReplicas(size_t pos, unsigned int count, vector<Node> &out) const {
+	if ( slotsStale ) {
+		rebuildSlots();
+	}
+	unsigned int buckets = bucketMember.size();
+	unsigned int bucket = jumpHash(pos, buckets);
+	for ( int attempt = 1; bucketMember[bucket] < 0 && attempt < JUMP_ATTEMPTS; attempt++ ) {
+		bucket = jumpHash(mix64(pos + attempt), buckets);
+	}
+	unsigned int picked = min(count, (unsigned int)members.size());
+	for ( unsigned int i = 0; picked > 0; i++ ) {
+		int member = bucketMember[(bucket + i) % buckets];
+		if ( member >= 0 ) {
+			out.push_back(toNode(members[member]));
+			picked--;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: affectedRanges
+ *
+ * DESCRIPTION: Append, for each position of a physical node, the range (start, end] of
+ * 				the keys whose replica walk reaches it. Walking back from the position,
+ * 				start is the first node at which count other physical nodes have been
+ * 				passed: the walk of a key at or before start is full before it gets
+ * 				there. Called with the node on the ring, after it joined or before it
+ * 				leaves, these are the only keys whose replicas change. The other
+ * 				placements, and zone aware placement whose walks skip nodes of zones
+ * 				already picked, have no ranges and return false.
+ */
+bool Ring::affectedRanges(Address &address, int vnodes, unsigned int count, vector<pair<size_t, size_t> > &ranges) const {
+	if ( placement != RING_PLACEMENT || zoneAware() || members.size() <= count ) {
+		// The node holds a replica of every key
+		return false;
+	}
+	vector<unsigned long> passed;
+	for ( int v = 0; v < vnodes; v++ ) {
+		Node node(address, v);
+		RingEntry position = toEntry(node);
+		vector<RingEntry>::const_iterator it = lower_bound(nodes.begin(), nodes.end(), position);
+		if ( it == nodes.end() || position < *it ) {
+			continue;
+		}
+		unsigned int i = it - nodes.begin(), j = i;
+		passed.clear();
+		while ( passed.size() < count ) {
+			j = (j + nodes.size() - 1) % nodes.size();
+			unsigned long other = nodes[j].address();
+			if ( other == position.address() || find(passed.begin(), passed.end(), other) != passed.end() ) {
+				continue;
+			}
+			passed.push_back(other);
+		}
+		ranges.push_back(make_pair(nodes[j].position, nodes[i].position));
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: addNeighbors
+ *
+ * DESCRIPTION: Walk from ring index i in direction step (1 or -1) over the first count
+ * 				distinct physical nodes other than address, and add those not in out yet
+ */
+static void addNeighbors(const vector<RingEntry> &nodes, unsigned int i, int step, unsigned long address, unsigned int count, vector<Node> &out) {
+	vector<unsigned long> passed;
+	for ( unsigned int walked = 1; walked < nodes.size() && passed.size() < count; walked++ ) {
+		const RingEntry &entry = nodes[(i + nodes.size() + step * (int)walked) % nodes.size()];
+		unsigned long other = entry.address();
+		if ( other == address || find(passed.begin(), passed.end(), other) != passed.end() ) {
+			continue;
+		}
+		passed.push_back(other);
+		Node node = Ring::toNode(entry);
+		bool known = false;
+		for ( unsigned int j = 0; j < out.size() && !known; j++ ) {
+			known = out[j].nodeAddress == node.nodeAddress;
+		}
+		if ( !known ) {
+			out.push_back(Node(node.nodeAddress));
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: neighborsOf
+ *
+ * DESCRIPTION: The nodes holding replicas of the keys a physical node is primary for
+ * 				(successors) and the nodes it holds replicas for (predecessors), in
+ * 				the order they were found
+ */
+bool Ring::neighborsOf(Address &address, int vnodes, unsigned int count, vector<Node> &successors, vector<Node> &predecessors) const {
+	successors.clear();
+	predecessors.clear();
+	if ( placement != RING_PLACEMENT || zoneAware() ) {
+		return false;
+	}
+	for ( int v = 0; v < vnodes; v++ ) {
+		Node node(address, v);
+		RingEntry position = toEntry(node);
+		vector<RingEntry>::const_iterator it = lower_bound(nodes.begin(), nodes.end(), position);
+		if ( it == nodes.end() || position < *it ) {
+			continue;
+		}
+		addNeighbors(nodes, it - nodes.begin(), 1, position.address(), count - 1, successors);
+		addNeighbors(nodes, it - nodes.begin(), -1, position.address(), count - 1, predecessors);
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: sameMembers
+ *
+ * DESCRIPTION: Whether two rings hold the same physical nodes, with as many positions each
+ */
+bool Ring::sameMembers(const Ring &other) const {
+	if ( members.size() != other.members.size() ) {
+		return false;
+	}
+	for ( unsigned int i = 0; i < members.size(); i++ ) {
+		if ( members[i].address() != other.members[i].address() || memberVnodes[i] != other.memberVnodes[i] ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: membersHash
+ *
+ * DESCRIPTION: FNV-1a over the physical nodes, which are kept in address order, and
+ * 				their number of positions. It names the membership the ring holds, not
+ * 				how or when the ring got there.
+ */
+unsigned int Ring::membersHash() const {
+	unsigned int hash = 2166136261U;
+	for ( unsigned int i = 0; i < members.size(); i++ ) {
+		unsigned long words[2] = {members[i].address(), (unsigned long)memberVnodes[i]};
+		const unsigned char *bytes = (const unsigned char *)words;
+		for ( size_t b = 0; b < sizeof(words); b++ ) {
+			hash = (hash ^ bytes[b]) * 16777619U;
+		}
+	}
+	return hash;
+}
+
+/**
+ * FUNCTION NAME: memoryUsage
+ *
+ * DESCRIPTION: Bytes held by the ring
+ */
+size_t Ring::memoryUsage() const {
+	return sizeof(Ring) + nodes.capacity() * sizeof(RingEntry) + members.capacity() * sizeof(RingEntry)
+		+ memberVnodes.capacity() * sizeof(int) + slotOwner.capacity() * sizeof(unsigned int)
+		+ bucketMember.capacity() * sizeof(int)
+		+ view.capacity() * sizeof(shared_ptr<const void>);
+}
+
+/**
+ * FUNCTION NAME: pool
+ *
+ * DESCRIPTION: The shared rings by the chunks of the membership they were built from
+ */
+Ring::Pool &Ring::pool() {
+	static Pool instance;
+	return instance;
+}
+
+/**
+ * FUNCTION NAME: poolLock
+ *
+ * DESCRIPTION: Lock held while the pool is read or written, every node shares the pool
+ */
+mutex &Ring::poolLock() {
+	static mutex instance;
+	return instance;
+}
+
+/**
+ * FUNCTION NAME: viewKey
+ *
+ * DESCRIPTION: Pool key of a membership view
+ */
+static vector<const void *> viewKey(const RingView &view) {
+	vector<const void *> key(view.size());
+	for ( unsigned int i = 0; i < view.size(); i++ ) {
+		key[i] = view[i].get();
+	}
+	return key;
+}
+
+/**
+ * FUNCTION NAME: findShared
+ *
+ * DESCRIPTION: The shared ring built from a membership view, NULL if there is none.
+ * 				The ring holds the chunks of its view, so no other chunk can take
+ * 				their addresses while the ring is in use.
+ */
+shared_ptr<const Ring> Ring::findShared(const RingView &view) {
+	if ( view.empty() ) {
+		return shared_ptr<const Ring>();
+	}
+	lock_guard<mutex> guard(poolLock());
+	return pooled(view);
+}
+
+/**
+ * FUNCTION NAME: pooled
+ *
+ * DESCRIPTION: The shared ring built from a non empty membership view, NULL if there
+ * 				is none. The caller holds the pool lock.
+ */
+shared_ptr<const Ring> Ring::pooled(const RingView &view) {
+	Pool::iterator it = pool().find(viewKey(view));
+	if ( it == pool().end() ) {
+		return shared_ptr<const Ring>();
+	}
+	shared_ptr<const Ring> ring = it->second.lock();
+	if ( !ring ) {
+		pool().erase(it);
+	}
+	return ring;
+}
+
+/**
+ * FUNCTION NAME: intern
+ *
+ * DESCRIPTION: Share a ring built from a membership view and take ownership of it. If
+ * 				another node shared one for the same view meanwhile, the built ring is
+ * 				dropped and that one returned. The slot table is built before the
+ * 				ring is shared, so shared rings are never written to. A ring with no
+ * 				view is returned unshared.
+ */
+shared_ptr<const Ring> Ring::intern(const RingView &view, Ring *ring) {
+	ring->rebuildSlots();
+	if ( view.empty() ) {
+		ring->view.clear();
+		return shared_ptr<const Ring>(ring);
+	}
+	lock_guard<mutex> guard(poolLock());
+	shared_ptr<const Ring> shared = pooled(view);
+	if ( shared ) {
+		delete ring;
+		return shared;
+	}
+	ring->view = view;
+	shared_ptr<const Ring> made(ring);
+	Pool &rings = pool();
+	rings[viewKey(view)] = made;
+
+	// Drop the rings no node uses any more once they are as many as the live ones
+	static unsigned int live = 1;
+	if ( rings.size() > 2 * live ) {
+		for ( Pool::iterator it = rings.begin(); it != rings.end(); ) {
+			if ( it->second.expired() ) {
+				rings.erase(it++);
+			}
+			else {
+				++it;
+			}
+		}
+		live = rings.size();
+	}
+	return made;
+}
@@ -0,0 +1,164 @@
+/**********************************
+ * FILE NAME: Ring.h
+ *
+ * DESCRIPTION: Consistent hashing ring of the KV store
+ **********************************/
+
+#ifndef RING_H_
+#define RING_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "Node.h"
+
+/*
+ * Macros
+ */
+// the slot table splits the ring into 2^RING_SLOT_BITS equal slots
+#define RING_SLOT_BITS 10
+// bits of a ring entry holding the position number of the node, below its 48 address bits
+#define RING_VNODE_BITS 16
+
+/**
+ * STRUCT NAME: RingEntry
+ *
+ * DESCRIPTION: A position on the ring in 16 bytes: the hash code and the node packed in
+ * 				one word. Plain data, so the sorted array of entries is searched and
+ * 				copied as contiguous memory, and nodes compare as integers.
+ */
+typedef struct RingEntry {
+	size_t position;
+	// address bytes in the high 48 bits, the position number of the node in the low 16
+	unsigned long node;
+	bool operator <(const RingEntry &another) const {
+		return position != another.position ? position < another.position : node < another.node;
+	}
+	unsigned long address() const {
+		return node >> RING_VNODE_BITS;
+	}
+} RingEntry;
+
+// the membership a ring was built from, as the chunks of its id and port columns
+typedef vector<shared_ptr<const void> > RingView;
+
+/**
+ * CLASS NAME: Ring
+ *
+ * DESCRIPTION: The nodes of the KV store and where the replicas of a key go.
+ * 				Positions are 64-bit hashes. Three placements are supported:
+ * 				RING_PLACEMENT: consistent hashing. The nodes sit at their positions
+ * 				(several per physical node with virtual nodes) in an array of
+ * 				RingEntry sorted by hash code, ties broken by address. The owner of a position is the first node at
+ * 				or after it, wrapping around, and the replicas are the next distinct
+ * 				physical nodes. Lookups are a short walk from a table of the first
+ * 				node of each slot of the ring, rebuilt on the first lookup after the
+ * 				ring changed. With zone aware placement the
+ * 				walk takes a node of each zone not holding a replica yet first,
+ * 				then fills up with the next distinct physical nodes.
+ * 				RENDEZVOUS_PLACEMENT: highest random weight. Every physical node scores
+ * 				the key, the highest scores win. Weights scale the scores.
+ * 				JUMP_PLACEMENT: jump consistent hash over buckets numbered by node id, up
+ * 				to the highest id on the ring. A key that jumps to the bucket of a node
+ * 				not on the ring jumps again, the replicas are the next buckets of nodes
+ * 				on the ring. Weights are not supported.
+ * 				Nodes with the same view of the membership share one immutable ring,
+ * 				interned by the chunks of the membership columns it was built from.
+ */
+class Ring {
+private:
+	int placement;
+	// every position of every node, sorted
+	vector<RingEntry> nodes;
+	// the first position of each physical node sorted by address, and their number of positions
+	vector<RingEntry> members;
+	vector<int> memberVnodes;
+	// ring index of the first node at or after the start of every slot
+	mutable vector<unsigned int> slotOwner;
+	// with jump placement, the index in members of the node with the id of each bucket, -1 if none
+	mutable vector<int> bucketMember;
+	mutable bool slotsStale;
+	// zone of each node id with zone aware placement, else NULL
+	const vector<int> *nodeZone;
+	int zoneCount;
+	// membership the ring was built from, empty unless the ring is shared
+	RingView view;
+	typedef map<vector<const void *>, weak_ptr<const Ring> > Pool;
+
+	static Pool &pool();
+	static mutex &poolLock();
+	// the shared ring of a view, NULL if there is none, called with the pool lock held
+	static shared_ptr<const Ring> pooled(const RingView &view);
+	void rebuildSlots() const;
+	int zoneOf(const RingEntry &entry) const;
+	// add a position in order, false if it is there already
+	bool insert(const RingEntry &entry);
+	// remove a position, false if it is not there
+	bool erase(const RingEntry &entry);
+	void ringReplicas(size_t pos, unsigned int count, vector<Node> &out) const;
+	void walkReplicas(unsigned int first, unsigned int count, vector<Node> &out) const;
+	void rendezvousReplicas(size_t pos, unsigned int count, vector<Node> &out) const;
+	void jumpReplicas(size_t pos, unsigned int count, vector<Node> &out) const;
+
+public:
+	Ring();
+	void setPlacement(int placement) {
+		this->placement = placement;
+		slotsStale = true;
+	}
+	// place the replicas of the ring placement in distinct zones first, if there are several
+	void setZones(const vector<int> *nodeZone, int zoneCount) {
+		this->nodeZone = zoneCount > 1 ? nodeZone : NULL;
+		this->zoneCount = zoneCount;
+	}
+	bool zoneAware() const {
+		return placement == RING_PLACEMENT && nodeZone != NULL;
+	}
+	// positions on the ring
+	unsigned int size() const {
+		return nodes.size();
+	}
+	bool empty() const {
+		return nodes.empty();
+	}
+	Node operator [](unsigned int i) const {
+		return toNode(nodes[i]);
+	}
+	static RingEntry toEntry(const Node &node);
+	static Node toNode(const RingEntry &entry);
+	// physical nodes
+	unsigned int memberCount() const {
+		return members.size();
+	}
+	// replace the nodes with the given positions, which need not be sorted
+	void assign(const vector<Node> &positions);
+	// add or remove all the positions of a physical node
+	void insertMember(Address &address, int vnodes);
+	void eraseMember(Address &address, int vnodes);
+	// ring index of the owner of a ring position, from the slot table
+	unsigned int ownerOf(size_t pos) const;
+	// the count distinct physical nodes holding the key hashed to pos, fewer if there are not as many
+	void replicasOf(size_t pos, unsigned int count, vector<Node> &out) const;
+	// replicasOf for many positions. The replicas of positions[i] are the setSize() nodes of
+	// replicas from setOf[i] * setSize(count) on
+	void replicasOfMany(const vector<size_t> &positions, unsigned int count, vector<unsigned int> &setOf, vector<Node> &replicas) const;
+	unsigned int setSize(unsigned int count) const {
+		return min(count, (unsigned int)members.size());
+	}
+	// append the ranges of positions whose count replicas go through a position of the physical node,
+	// false if that can be any position
+	bool affectedRanges(Address &address, int vnodes, unsigned int count, vector<pair<size_t, size_t> > &ranges) const;
+	// the distinct physical nodes among the count - 1 after and before each position of the physical node,
+	// false if the placement has no neighbors
+	bool neighborsOf(Address &address, int vnodes, unsigned int count, vector<Node> &successors, vector<Node> &predecessors) const;
+	// whether both rings hold the same physical nodes with the same number of positions
+	bool sameMembers(const Ring &other) const;
+	// hash of the physical nodes and their number of positions, equal for rings with the same members
+	unsigned int membersHash() const;
+	size_t memoryUsage() const;
+	// the shared ring built from a membership view, NULL if there is none
+	static shared_ptr<const Ring> findShared(const RingView &view);
+	// shares a ring built from a membership view and owns it, or returns the one shared already
+	static shared_ptr<const Ring> intern(const RingView &view, Ring *ring);
+};
+
+#endif /* RING_H_ */
@@ -8,8 +8,13 @@
 static int g_transID = 0;
 
 // message types, reply is the message from node to coordinator
-enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY};
-// enum of replica types
-enum ReplicaType {PRIMARY, SECONDARY, TERTIARY};
+// redirect is the answer of a node with a newer ring to a request for a key it does not hold
+enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY, REDIRECT};
+// enum of replica types: position of a replica in the preference list of its key.
+// Values past TERTIARY are the further replicas of a replication factor above 3.
+enum ReplicaType : int {PRIMARY, SECONDARY, TERTIARY};
+// replicas a request waits for: the cluster setting, one, a majority or all of them,
+// or a majority of those in the zone of the coordinator
+enum ConsistencyLevel {CONSISTENCY_DEFAULT, ONE, QUORUM, ALL, LOCAL_QUORUM};
 
 #endif
@@ -10,7 +10,6 @@
 /*
  * Macros
  */
-#define RING_SIZE 512
 #define FAILURE -1
 #define SUCCESS 0
 
@@ -31,10 +30,18 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <set>
 #include <string>
 #include <algorithm>
 #include <queue>
+#include <deque>
 #include <fstream>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 